@@ -0,0 +1,195 @@
+#ifndef ADMIN_SERVER_H
+#define ADMIN_SERVER_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+#include "trace.h"
+
+#define ADMIN_REQUEST_SIZE 1024        // 请求只读取这么多字节，足够容纳请求行
+#define ADMIN_IO_TIMEOUT_MS 1000       // 单个抓取连接的读写超时，防止慢客户端占住管理线程
+
+// 本地管理端口
+// 在独立线程上监听本地TCP或UNIX套接字，每个连接返回一次Prometheus文本格式的指标快照后关闭；
+// GET /trace返回追踪区间的Chrome trace JSON（需启用追踪）。
+// 抓取只读取原子计数器和调用采集函数，不与聊天线程争用锁，也不在聊天线程上做任何格式化。
+// 地址格式："unix:/path/to.sock"为UNIX套接字，"host:port"或"port"为TCP（默认只绑定127.0.0.1）。
+class AdminServer {
+public:
+    AdminServer() : m_listen_fd(-1), m_stopping(false) {}
+    ~AdminServer() { Stop(); }
+
+    bool Start(const std::string& address) {
+        if (m_listen_fd >= 0) {
+            return true;
+        }
+        m_listen_fd = address.compare(0, 5, "unix:") == 0 ? ListenUnix(address.substr(5)) : ListenTcp(address);
+        if (m_listen_fd < 0) {
+            return false;
+        }
+        m_stopping = false;
+        m_thread = std::thread(&AdminServer::ServeLoop, this);
+        return true;
+    }
+
+    void Stop() {
+        if (m_listen_fd < 0) {
+            return;
+        }
+        m_stopping = true;
+        shutdown(m_listen_fd, SHUT_RDWR);   // 唤醒阻塞在accept上的管理线程
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        if (!m_unix_path.empty()) {
+            unlink(m_unix_path.c_str());
+            m_unix_path.clear();
+        }
+    }
+
+private:
+    int ListenTcp(const std::string& address) {
+        std::string host = "127.0.0.1";
+        std::string port = address;
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(port.c_str()));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            fprintf(stderr, "管理端口地址无效: %s\n", address.c_str());
+            return -1;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("admin socket");
+            return -1;
+        }
+        int opt = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+            perror("admin bind");
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int ListenUnix(const std::string& path) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "管理套接字路径无效: %s\n", path.c_str());
+            return -1;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("admin socket");
+            return -1;
+        }
+        unlink(path.c_str());   // 清理上次运行残留的套接字文件
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+            perror("admin bind");
+            ::close(fd);
+            return -1;
+        }
+        m_unix_path = path;
+        return fd;
+    }
+
+    void ServeLoop() {
+        while (!m_stopping) {
+            int client = accept4(m_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                break;
+            }
+            ServeClient(client);
+            ::close(client);
+        }
+    }
+
+    // 读取请求行：HTTP GET响应/、/metrics与/trace，其他任何内容（如nc直接连接）都返回纯文本指标快照
+    void ServeClient(int client) {
+        struct timeval timeout;
+        timeout.tv_sec = ADMIN_IO_TIMEOUT_MS / 1000;
+        timeout.tv_usec = ADMIN_IO_TIMEOUT_MS % 1000 * 1000;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        char request[ADMIN_REQUEST_SIZE];
+        ssize_t n = recv(client, request, sizeof(request) - 1, 0);
+        request[n > 0 ? n : 0] = '\0';
+
+        if (strncmp(request, "GET ", 4) != 0) {
+            SendAll(client, MetricsRegistry::GetInstance().PrometheusText());
+            return;
+        }
+
+        const char* start = request + 4;
+        std::string path(start, strcspn(start, " ?\r\n"));
+        std::string status = "200 OK";
+        std::string type = "text/plain; version=0.0.4; charset=utf-8";
+        std::string body;
+        if (path == "/" || path == "/metrics") {
+            body = MetricsRegistry::GetInstance().PrometheusText();
+        } else if (path == "/trace") {
+            type = "application/json";
+            body = TraceRecorder::GetInstance().ChromeJson();
+        } else {
+            status = "404 Not Found";
+            body = "not found\n";
+        }
+        std::string header = "HTTP/1.0 " + status + "\r\n"
+                             "Content-Type: " + type + "\r\n"
+                             "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                             "Connection: close\r\n\r\n";
+        SendAll(client, header + body);
+    }
+
+    static void SendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            sent += n;
+        }
+    }
+
+    int m_listen_fd;
+    std::string m_unix_path;            // UNIX套接字文件，停止时删除
+    std::atomic<bool> m_stopping;
+    std::thread m_thread;               // 管理线程
+};
+
+#endif // ADMIN_SERVER_H
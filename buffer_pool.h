@@ -0,0 +1,278 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "metrics.h"
+
+// 大小级别：聊天消息大多小于256字节，1024/2048容纳单条消息帧，更大的级别用于批量数据
+#define POOL_CLASS_COUNT 9
+#define POOL_THREAD_CACHE 64        // 每个线程每个级别最多缓存的空闲块数
+#define POOL_CENTRAL_LIMIT 4096     // 共享空闲链表每个级别最多保留的块数，超出的块归还给系统
+#define POOL_ARENA_CHUNK 4096       // 区域分配器每次从池中取的块大小
+
+static const size_t POOL_CLASS_SIZES[POOL_CLASS_COUNT] = {64, 128, 256, 512, 1024, 2048, 4096, 16384, 65536};
+
+// 缓冲池统计信息
+struct BufferPoolStats {
+    uint64_t allocs;           // 分配次数
+    uint64_t cache_hits;       // 由线程缓存满足的次数
+    uint64_t central_hits;     // 由共享空闲链表满足的次数
+    uint64_t misses;           // 需要向系统申请新块的次数（含超过最大级别的分配）
+    uint64_t bytes_held;       // 池持有的全部内存（使用中加空闲）
+    uint64_t bytes_in_use;     // 已分配给调用方的内存（按级别大小计）
+
+    // 池命中率（百分比）
+    double HitRate() const {
+        return allocs == 0 ? 0.0 : (cache_hits + central_hits) * 100.0 / allocs;
+    }
+};
+
+// 按大小分级的消息缓冲池
+// 每个级别有一个共享空闲链表，每个线程另有一份无锁的线程缓存：分配和释放先走线程缓存，
+// 线程缓存空了从共享链表批量取一半，满了把一半还给共享链表，线程退出时全部归还。
+// 每个块前有16字节的块头记录所属级别，Release不需要调用方提供长度。
+class BufferPool {
+public:
+    static BufferPool& GetInstance() {
+        static BufferPool instance;
+        return instance;
+    }
+
+    // 返回能容纳size字节的级别，超过最大级别返回-1
+    static int SizeClass(size_t size) {
+        for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+            if (size <= POOL_CLASS_SIZES[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // 分配至少size字节，capacity返回实际可用的字节数
+    void* Allocate(size_t size, size_t* capacity = NULL) {
+        int cls = SizeClass(size);
+        m_allocs.Inc();
+        if (cls < 0) {
+            // 超过最大级别：直接向系统申请，释放时直接归还
+            m_misses.Inc();
+            BlockHeader* block = NewBlock(size, -1);
+            if (capacity != NULL) {
+                *capacity = size;
+            }
+            return block + 1;
+        }
+
+        ThreadCache& cache = LocalCache();
+        std::vector<BlockHeader*>& free_list = cache.free[cls];
+        BlockHeader* block;
+        if (!free_list.empty()) {
+            m_cache_hits.Inc();
+            block = free_list.back();
+            free_list.pop_back();
+        } else if (Refill(cls, free_list)) {
+            m_central_hits.Inc();
+            block = free_list.back();
+            free_list.pop_back();
+        } else {
+            m_misses.Inc();
+            block = NewBlock(POOL_CLASS_SIZES[cls], cls);
+        }
+        m_allocated[cls].Inc();
+        if (capacity != NULL) {
+            *capacity = POOL_CLASS_SIZES[cls];
+        }
+        return block + 1;
+    }
+
+    void Release(void* ptr) {
+        if (ptr == NULL) {
+            return;
+        }
+        BlockHeader* block = (BlockHeader*)ptr - 1;
+        if (block->cls < 0) {
+            m_bytes_held.fetch_sub(block->size, std::memory_order_relaxed);
+            free(block);
+            return;
+        }
+        int cls = block->cls;
+        m_freed[cls].Inc();
+        std::vector<BlockHeader*>& free_list = LocalCache().free[cls];
+        if (free_list.size() >= POOL_THREAD_CACHE) {
+            Drain(cls, free_list, POOL_THREAD_CACHE / 2);
+        }
+        free_list.push_back(block);
+    }
+
+    BufferPoolStats GetStats() const {
+        BufferPoolStats stats;
+        stats.allocs = m_allocs.Value();
+        stats.cache_hits = m_cache_hits.Value();
+        stats.central_hits = m_central_hits.Value();
+        stats.misses = m_misses.Value();
+        stats.bytes_held = m_bytes_held.load(std::memory_order_relaxed);
+        stats.bytes_in_use = 0;
+        for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+            uint64_t freed = m_freed[i].Value();
+            uint64_t allocated = m_allocated[i].Value();
+            if (allocated > freed) {
+                stats.bytes_in_use += (allocated - freed) * POOL_CLASS_SIZES[i];
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct BlockHeader {
+        int32_t cls;               // 所属级别，-1表示超过最大级别的直接分配
+        uint32_t reserved;
+        uint64_t size;             // 块的可用字节数
+    };
+
+    // 线程缓存：线程退出时把空闲块归还给共享链表
+    struct ThreadCache {
+        std::vector<BlockHeader*> free[POOL_CLASS_COUNT];
+
+        ~ThreadCache() {
+            BufferPool& pool = BufferPool::GetInstance();
+            for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+                pool.Drain(i, free[i], free[i].size());
+            }
+        }
+    };
+
+    BufferPool() : m_bytes_held(0) {}
+
+    ~BufferPool() {
+        for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+            for (size_t j = 0; j < m_central[i].size(); j++) {
+                free(m_central[i][j]);
+            }
+        }
+    }
+
+    static ThreadCache& LocalCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    BlockHeader* NewBlock(size_t size, int cls) {
+        BlockHeader* block = (BlockHeader*)malloc(sizeof(BlockHeader) + size);
+        if (block == NULL) {
+            throw std::bad_alloc();
+        }
+        block->cls = cls;
+        block->reserved = 0;
+        block->size = size;
+        m_bytes_held.fetch_add(size, std::memory_order_relaxed);
+        return block;
+    }
+
+    // 从共享链表取最多半个线程缓存的块
+    bool Refill(int cls, std::vector<BlockHeader*>& free_list) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<BlockHeader*>& central = m_central[cls];
+        size_t count = std::min(central.size(), (size_t)POOL_THREAD_CACHE / 2);
+        free_list.insert(free_list.end(), central.end() - count, central.end());
+        central.resize(central.size() - count);
+        return count > 0;
+    }
+
+    // 把线程缓存末尾的count个块还给共享链表，共享链表已满的部分归还给系统
+    void Drain(int cls, std::vector<BlockHeader*>& free_list, size_t count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<BlockHeader*>& central = m_central[cls];
+        for (size_t i = free_list.size() - count; i < free_list.size(); i++) {
+            if (central.size() < POOL_CENTRAL_LIMIT) {
+                central.push_back(free_list[i]);
+            } else {
+                m_bytes_held.fetch_sub(free_list[i]->size, std::memory_order_relaxed);
+                free(free_list[i]);
+            }
+        }
+        free_list.resize(free_list.size() - count);
+    }
+
+    std::mutex m_mutex;                                   // 保护共享空闲链表
+    std::vector<BlockHeader*> m_central[POOL_CLASS_COUNT];
+    MetricCounter m_allocs;
+    MetricCounter m_cache_hits;
+    MetricCounter m_central_hits;
+    MetricCounter m_misses;
+    MetricCounter m_allocated[POOL_CLASS_COUNT];         // 各级别累计分配次数
+    MetricCounter m_freed[POOL_CLASS_COUNT];             // 各级别累计释放次数
+    std::atomic<uint64_t> m_bytes_held;
+};
+
+// 池化缓冲区：析构时归还给缓冲池，只能移动不能复制
+class PooledBuffer {
+public:
+    PooledBuffer() : m_data(NULL), m_capacity(0) {}
+    explicit PooledBuffer(size_t size) : m_capacity(0) {
+        m_data = (char*)BufferPool::GetInstance().Allocate(size, &m_capacity);
+    }
+    PooledBuffer(PooledBuffer&& other) : m_data(other.m_data), m_capacity(other.m_capacity) {
+        other.m_data = NULL;
+        other.m_capacity = 0;
+    }
+    PooledBuffer& operator=(PooledBuffer&& other) {
+        if (this != &other) {
+            BufferPool::GetInstance().Release(m_data);
+            m_data = other.m_data;
+            m_capacity = other.m_capacity;
+            other.m_data = NULL;
+            other.m_capacity = 0;
+        }
+        return *this;
+    }
+    ~PooledBuffer() { BufferPool::GetInstance().Release(m_data); }
+
+    char* data() const { return m_data; }
+    size_t capacity() const { return m_capacity; }
+
+private:
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    char* m_data;
+    size_t m_capacity;
+};
+
+// 区域分配器：在从缓冲池取得的块中顺序分配，析构时一次归还全部块。
+// 用于握手等生命周期明确的临时数据，单次分配不需要释放。不是线程安全的。
+class BufferArena {
+public:
+    BufferArena() : m_used(0), m_bytes(0) {}
+
+    // 分配size字节（按8字节对齐）
+    char* Allocate(size_t size) {
+        size = (size + 7) & ~(size_t)7;
+        if (m_chunks.empty() || m_used + size > m_chunks.back().capacity()) {
+            m_chunks.push_back(PooledBuffer(size > POOL_ARENA_CHUNK ? size : POOL_ARENA_CHUNK));
+            m_used = 0;
+        }
+        char* ptr = m_chunks.back().data() + m_used;
+        m_used += size;
+        m_bytes += size;
+        return ptr;
+    }
+
+    size_t BytesAllocated() const { return m_bytes; }   // 累计分配的字节数
+
+private:
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    std::vector<PooledBuffer> m_chunks;
+    size_t m_used;            // 最后一个块已用的字节数
+    size_t m_bytes;
+};
+
+#endif // BUFFER_POOL_H
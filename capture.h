@@ -0,0 +1,165 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define CAPTURE_MAGIC "CHATCAP1"
+#define CAPTURE_FLUSH_MS 1000          // 后台线程刷新文件缓冲的间隔
+#define CAPTURE_BUFFER_SIZE (64 * 1024)
+
+// 捕获事件
+enum CaptureEvent {
+    CAPTURE_OPEN = 1,      // 握手完成，flags表示握手方式
+    CAPTURE_FRAME = 2,     // 收到并成功解密一帧
+    CAPTURE_CLOSE = 3      // 连接结束
+};
+
+#define CAPTURE_FLAG_RESUMED 0x01      // OPEN：通过票据恢复的会话
+#define CAPTURE_FLAG_EARLY 0x02        // FRAME：随握手到达的0-RTT消息
+
+// 文件头，其后是连续的CaptureRecord；字段按本机字节序写入，与二进制日志相同
+struct CaptureFileHeader {
+    char magic[8];
+    uint64_t start_real_ns;   // 开始捕获时的实时时钟
+    uint64_t start_mono_ns;   // 开始捕获时的单调时钟，记录的时间以它为起点
+};
+
+// 一条捕获记录（24字节），只记录帧的类型与长度，不保存消息内容
+struct CaptureRecord {
+    uint64_t offset_ns;       // 相对开始捕获的时间
+    uint32_t conn_id;         // 连接编号，从1开始
+    uint8_t event;            // CaptureEvent
+    uint8_t type;             // FRAME：帧类型
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t size;            // FRAME：明文长度（多会话服务器不解密批量数据块，记为0）
+    uint32_t wire_size;       // FRAME：帧在线路上的长度（帧头加密文）
+};
+
+// 流量捕获
+// 服务端在握手完成、收到每一帧、连接结束时写一条定长记录，回放工具据此以相同的时序与帧长度
+// 重新驱动服务器。写入经过互斥锁进入stdio缓冲，由后台线程定期刷新；未启用时只检查一次原子标志。
+class CaptureWriter {
+public:
+    static CaptureWriter& GetInstance() {
+        static CaptureWriter instance;
+        return instance;
+    }
+
+    bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 创建捕获文件并开始记录；只能调用一次
+    bool Open(const std::string& path) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file != NULL) {
+            return true;
+        }
+        m_file = fopen(path.c_str(), "wb");
+        if (m_file == NULL) {
+            perror("capture open");
+            return false;
+        }
+        setvbuf(m_file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+        CaptureFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        header.start_real_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        header.start_mono_ns = NowNs();
+        m_start_ns = header.start_mono_ns;
+        fwrite(&header, sizeof(header), 1, m_file);
+
+        m_flusher = std::thread(&CaptureWriter::FlushLoop, this);
+        m_enabled.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // 握手完成：分配连接编号并记录，未启用时返回0
+    uint32_t OpenConnection(bool resumed) {
+        if (!Enabled()) {
+            return 0;
+        }
+        uint32_t id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+        Write(id, CAPTURE_OPEN, 0, resumed ? CAPTURE_FLAG_RESUMED : 0, 0, 0);
+        return id;
+    }
+
+    void RecordFrame(uint32_t id, uint8_t type, uint32_t size, uint32_t wire_size, uint8_t flags = 0) {
+        if (id != 0) {
+            Write(id, CAPTURE_FRAME, type, flags, size, wire_size);
+        }
+    }
+
+    void CloseConnection(uint32_t id) {
+        if (id != 0) {
+            Write(id, CAPTURE_CLOSE, 0, 0, 0, 0);
+        }
+    }
+
+private:
+    CaptureWriter() : m_enabled(false), m_file(NULL), m_start_ns(0), m_next_id(1), m_stopping(false) {}
+
+    ~CaptureWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        if (m_flusher.joinable()) {
+            m_flusher.join();
+        }
+        if (m_file != NULL) {
+            fclose(m_file);
+        }
+    }
+
+    static uint64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Write(uint32_t id, uint8_t event, uint8_t type, uint8_t flags, uint32_t size, uint32_t wire_size) {
+        CaptureRecord record;
+        record.offset_ns = NowNs() - m_start_ns;
+        record.conn_id = id;
+        record.event = event;
+        record.type = type;
+        record.flags = flags;
+        record.reserved = 0;
+        record.size = size;
+        record.wire_size = wire_size;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        fwrite(&record, sizeof(record), 1, m_file);
+    }
+
+    // 定期把缓冲的记录写入文件，进程被信号终止时最多丢失最近一个周期的记录
+    void FlushLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping) {
+            m_wake.wait_for(lock, std::chrono::milliseconds(CAPTURE_FLUSH_MS));
+            fflush(m_file);
+        }
+    }
+
+    std::atomic<bool> m_enabled;
+    std::mutex m_mutex;                 // 保护文件写入
+    FILE* m_file;
+    uint64_t m_start_ns;
+    std::atomic<uint32_t> m_next_id;    // 下一个连接编号
+    bool m_stopping;
+    std::condition_variable m_wake;
+    std::thread m_flusher;              // 后台刷新线程
+};
+
+#endif // CAPTURE_H
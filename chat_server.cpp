@@ -0,0 +1,99 @@
+#include "chat_server.h"
+#include <thread>
+
+CChatServer::CChatServer()
+    : m_handshaking(0), m_max_sessions(CHAT_SERVER_MAX_SESSIONS),
+      m_handshake_timeout_ms(CHAT_SERVER_HANDSHAKE_TIMEOUT_MS), m_handshake_timers(SESSION_TICK_MS) {
+}
+
+void CChatServer::SetTimeouts(int handshake_ms, int idle_ms, int heartbeat_ms) {
+    m_handshake_timeout_ms = handshake_ms > 0 ? handshake_ms : 0;
+    m_loop.SetIdlePolicy(idle_ms, heartbeat_ms);
+}
+
+// 初始化并开始监听
+bool CChatServer::Start(int port, int max_sessions) {
+    m_max_sessions = max_sessions > 0 ? max_sessions : CHAT_SERVER_MAX_SESSIONS;
+    LOG_INIT("chatroom_server.log", WARNING, INFO);
+    m_listener.SetQuiet(true);
+    if (!m_loop.Start() || !m_listener.InitServer(port) || !m_listener.StartListen(CHAT_SERVER_BACKLOG)) {
+        return false;
+    }
+    if (m_handshake_timeout_ms > 0) {
+        m_handshake_timers.Start(TraceNowNs() / 1000000);
+        std::thread(&CChatServer::WatchHandshakes, this).detach();
+    }
+    return true;
+}
+
+// 接受连接，每个连接交给一个握手线程
+void CChatServer::Run() {
+    static MetricCounter& rejected = MetricsRegistry::GetInstance().Counter(
+        "chat_sessions_rejected_total", "因会话数达到上限被拒绝的连接数");
+    
+    while (1) {
+        struct sockaddr_in addr;
+        int fd = m_listener.AcceptClient(addr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) {
+                continue;
+            }
+            return;
+        }
+        
+        if (m_handshaking.load() + m_loop.SessionCount() >= m_max_sessions) {
+            rejected.Inc();
+            close(fd);
+            continue;
+        }
+        m_handshaking++;
+        std::thread(&CChatServer::ServeSession, this, fd, addr).detach();
+    }
+}
+
+// 握手线程：完成握手后把连接交给事件循环，线程与CTcpSocket随即释放
+void CChatServer::ServeSession(int fd, struct sockaddr_in addr) {
+    {
+        CTcpSocket session;
+        session.SetQuiet(true);
+        session.AdoptClient(fd, addr, &m_tickets);
+        // 随握手到达的消息等会话进入事件循环后再转发
+        std::string early;
+        session.SetMessageHandler([&early](const char* text, int len) {
+            early.assign(text, len);
+        });
+        
+        if (m_handshake_timeout_ms > 0) {
+            std::lock_guard<std::mutex> lock(m_handshake_mutex);
+            m_handshake_timers.Schedule(fd, m_handshake_timeout_ms);
+        }
+        bool resumed = false;
+        bool established = session.EstablishSecureServer(resumed);
+        // 先撤销期限再交出或关闭描述符，监视线程不会关闭到复用了该描述符的新连接
+        if (m_handshake_timeout_ms > 0) {
+            std::lock_guard<std::mutex> lock(m_handshake_mutex);
+            m_handshake_timers.Cancel(fd);
+        }
+        if (established) {
+            uint32_t capture_id = session.CaptureId();
+            m_loop.Adopt(session.DetachClient(), addr, session.SessionKey(), session.SendSeq(),
+                         capture_id, early);
+        }
+    }
+    m_handshaking--;
+}
+
+// 监视线程：每个节拍推进一次时间轮，关闭到期握手的读写两个方向，阻塞在握手中的线程随之失败返回
+void CChatServer::WatchHandshakes() {
+    static MetricCounter& timeouts = MetricsRegistry::GetInstance().Counter(
+        "chat_handshake_timeouts_total", "超过时长上限被关闭的握手数");
+    
+    while (1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_handshake_timers.TickMs()));
+        std::lock_guard<std::mutex> lock(m_handshake_mutex);
+        m_handshake_timers.Advance(TraceNowNs() / 1000000, [](int fd) {
+            timeouts.Inc();
+            shutdown(fd, SHUT_RDWR);
+        });
+    }
+}
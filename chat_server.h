@@ -0,0 +1,46 @@
+#ifndef CHAT_SERVER_H
+#define CHAT_SERVER_H
+
+#include <atomic>
+#include <mutex>
+
+#include "tcp_socket.h"
+#include "session_loop.h"
+#include "timer_wheel.h"
+
+#define CHAT_SERVER_BACKLOG 128          // 多会话服务器的监听队列长度
+#define CHAT_SERVER_MAX_SESSIONS 1024    // 默认最大并发会话数
+#define CHAT_SERVER_HANDSHAKE_TIMEOUT_MS 10000  // 握手的总时长上限，防止停滞或逐字节发送的客户端占住握手线程
+
+// 多会话聊天服务器
+// 每个连接由独立线程完成握手，握手完成后交给事件循环（CSessionLoop）：聊天消息转发给其他所有
+// 已建立的会话，延迟探测帧由事件循环回应。服务器不读取控制台输入，也不在控制台显示消息，可用于压力测试。
+class CChatServer {
+public:
+    CChatServer();
+
+    bool Start(int port = DEFAULT_PORT, int max_sessions = CHAT_SERVER_MAX_SESSIONS);  // 初始化并开始监听
+    void Run();                                                        // 接受连接，直到监听套接字出错
+
+    // 设置握手时长上限、空闲超时与心跳间隔（毫秒），0表示关闭；在Start之前调用
+    void SetTimeouts(int handshake_ms, int idle_ms, int heartbeat_ms);
+    // 设置每个连接每秒的帧数与字节数上限，0表示不限；在Start之前调用
+    void SetRateLimit(int msgs_per_sec, int bytes_per_sec) { m_loop.SetRateLimit(msgs_per_sec, bytes_per_sec); }
+    // 设置会话发送方向的换钥阈值（字节、秒），0表示不按该条件换钥；在Start之前调用
+    void SetRekeyPolicy(uint64_t bytes, int seconds) { m_loop.SetRekeyPolicy(bytes, seconds); }
+
+private:
+    void ServeSession(int fd, struct sockaddr_in addr);                // 握手线程
+    void WatchHandshakes();                                            // 关闭超过时长上限的握手
+
+    CTcpSocket m_listener;                 // 监听套接字
+    SessionTicketManager m_tickets;        // 所有会话共用的票据管理器
+    CSessionLoop m_loop;                   // 已建立会话的事件循环
+    std::atomic<int> m_handshaking;        // 握手中的连接数
+    int m_max_sessions;
+    int m_handshake_timeout_ms;
+    std::mutex m_handshake_mutex;          // 保护m_handshake_timers
+    TimerWheel m_handshake_timers;         // 以描述符为编号的握手期限
+};
+
+#endif // CHAT_SERVER_H
@@ -0,0 +1,554 @@
+// 多客户端压力测试工具：并发建立N个完整RSA/DES握手的会话，按设定速率与长度分布发送探测消息，
+// 报告握手速率、消息吞吐量以及p50/p99/p999投递延迟。
+// 消息以延迟探测帧发送，服务端解密后重新加密发回，延迟覆盖两端的加密、传输、校验与解密。
+// 握手风暴模式（--storm）只测量连接建立能力：每个并发连接反复建立短连接、完成握手后立即断开，
+// 并发数从1开始逐级翻倍到-n，每级持续-d秒，报告握手速率、失败与超时次数、每次握手的CPU时间与耗时分布，
+// 吞吐量连续两级不再增长时视为饱和并停止。
+// 空闲连接模式（--idle）建立-n个完成握手后不再收发的连接并保持-d秒，读取服务器常驻内存的增长，
+// 报告每个空闲连接占用的服务端内存。
+// 批量数据模式（--bulk 块大小）让每个会话同时在批量通道上不停发送数据，探测帧走控制通道，
+// 投递延迟反映块大小对交互消息的阻塞。
+// 用法: ./chatload [-a 地址] [-p 端口] [-n 会话数] [-r 每会话每秒消息数] [-s 长度分布] [-d 秒数] [--json]
+//       ./chatload --storm [-n 最大并发数] [-d 每级秒数] [-t 超时毫秒] [--server-pid 服务器进程号] [--json]
+//       ./chatload --idle [-n 连接数] [-d 保持秒数] [--server-pid 服务器进程号] [--json]
+//       ./chatload --bulk 块大小 [其他选项同第一种用法]
+//   -r 0        不限速，由TCP流控决定发送速度
+//   -s 64       所有消息64字节；-s 64:90,1024:10 表示90%为64字节、10%为1024字节
+//   --server-pid 服务器在本机运行时，读取/proc统计其每次握手消耗的CPU时间
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "tcp_socket.h"
+#include "connection_table.h"
+
+#define LOAD_GRACE_MS 500          // 发送结束后等待在途应答的时间
+#define STORM_TIMEOUT_MS 5000      // 风暴模式下单次连接加握手的默认超时
+#define STORM_MIN_GAIN 1.05        // 并发翻倍后吞吐量增长不足5%视为没有增长
+#define IDLE_WORKERS 16            // 空闲连接模式中并发建立连接的线程数
+#define IDLE_SETTLE_MS 1000        // 连接全部建立后等待服务器接管完毕再读取内存
+#define BULK_SEGMENT (1024 * 1024) // 批量数据模式每次SendBulk发送的数据量
+
+// 消息长度分布中的一项
+struct SizeWeight {
+    int size;
+    int weight;
+};
+
+struct LoadOptions {
+    std::string address;
+    int port;
+    int sessions;
+    double rate;                   // 每会话每秒消息数，0表示不限速
+    std::vector<SizeWeight> sizes;
+    int duration;                  // 发送时长（秒）；风暴模式下为每级时长
+    bool json;
+    bool storm;                    // 握手风暴模式
+    bool idle;                     // 空闲连接模式
+    int timeout_ms;                // 风暴模式的连接与握手超时
+    int server_pid;                // 本机服务器进程号，0表示不统计服务端CPU
+    int bulk_chunk;                // 批量数据的块大小，0表示不发送批量数据
+};
+
+// 风暴模式中一个并发级别的统计
+struct StormLevel {
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> timeouts;
+    MetricHistogram latency;       // 连接加握手耗时（微秒）
+
+    StormLevel() : completed(0), failures(0), timeouts(0) {}
+};
+
+// 单个会话的结果
+struct SessionResult {
+    bool connected;
+    bool handshake_ok;
+    uint64_t handshake_done_ns;    // 握手完成时间（相对开始时间）
+    uint64_t sent;
+    uint64_t bytes;
+    uint64_t bulk_bytes;           // 批量通道发送的字节数
+};
+
+static uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 解析"64"或"64:90,1024:10"形式的长度分布
+static bool ParseSizes(const char* text, std::vector<SizeWeight>& sizes) {
+    sizes.clear();
+    const char* p = text;
+    while (*p) {
+        SizeWeight item;
+        char* end;
+        item.size = strtol(p, &end, 10);
+        item.weight = 1;
+        if (end == p || item.size <= 0) {
+            return false;
+        }
+        p = end;
+        if (*p == ':') {
+            item.weight = strtol(p + 1, &end, 10);
+            if (end == p + 1 || item.weight <= 0) {
+                return false;
+            }
+            p = end;
+        }
+        sizes.push_back(item);
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return false;
+        }
+    }
+    return !sizes.empty();
+}
+
+static void RunSession(const LoadOptions& options, int index, uint64_t start_ns, MetricHistogram& handshake_latency,
+                       SessionResult& result) {
+    memset(&result, 0, sizeof(result));
+
+    CTcpSocket socket;
+    socket.SetQuiet(true);
+    socket.SetSessionResumption(false);
+    if (!socket.ConnectToServer(options.address.c_str(), options.port)) {
+        return;
+    }
+    result.connected = true;
+
+    MetricStopwatch timer;
+    if (!socket.EstablishSecureClient()) {
+        return;
+    }
+    handshake_latency.Record(timer.ElapsedUs());
+    result.handshake_ok = true;
+    result.handshake_done_ns = NowNs() - start_ns;
+
+    std::atomic<bool> stop(false);
+    std::thread receiver([&socket, &stop]() { socket.ReceiveLoop(stop); });
+    std::thread bulk;
+    if (options.bulk_chunk > 0) {
+        socket.SetBulkChunkSize(options.bulk_chunk);
+        bulk = std::thread([&socket, &stop, &result]() {
+            std::vector<char> segment(BULK_SEGMENT, 'b');
+            uint64_t offset = 0;
+            while (!stop && socket.SendBulk(1, segment.data(), segment.size(), offset, false)) {
+                offset += segment.size();
+            }
+            result.bulk_bytes = offset;
+        });
+    }
+
+    int total_weight = 0;
+    for (size_t i = 0; i < options.sizes.size(); i++) {
+        total_weight += options.sizes[i].weight;
+    }
+    std::mt19937 gen(index);
+    std::uniform_int_distribution<int> pick(0, total_weight - 1);
+
+    uint64_t interval_ns = options.rate > 0 ? (uint64_t)(1e9 / options.rate) : 0;
+    uint64_t begin = NowNs();
+    uint64_t deadline = begin + (uint64_t)options.duration * 1000000000ULL;
+    uint64_t next = begin;
+    while (NowNs() < deadline) {
+        if (interval_ns > 0) {
+            next += interval_ns;
+            uint64_t now = NowNs();
+            if (next > now) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+            }
+        }
+
+        int roll = pick(gen);
+        int size = options.sizes[0].size;
+        for (size_t i = 0; i < options.sizes.size(); i++) {
+            roll -= options.sizes[i].weight;
+            if (roll < 0) {
+                size = options.sizes[i].size;
+                break;
+            }
+        }
+        if (!socket.SendPing(size)) {
+            break;
+        }
+        result.sent++;
+        result.bytes += size;
+    }
+
+    // 等待在途的应答，然后关闭连接结束接收线程
+    std::this_thread::sleep_for(std::chrono::milliseconds(LOAD_GRACE_MS));
+    stop = true;
+    socket.ShutdownConnection();
+    receiver.join();
+    if (bulk.joinable()) {
+        bulk.join();
+    }
+}
+
+// 本进程已消耗的CPU时间（用户态加内核态，微秒）
+static uint64_t SelfCpuUs() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// 从/proc/<pid>/stat读取其他进程已消耗的CPU时间（微秒），读取失败返回0
+static uint64_t ProcessCpuUs(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char stat[1024];
+    size_t n = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[n] = '\0';
+
+    // 进程名可能含空格，从最后一个')'之后开始数：状态是第3个字段，utime与stime是第14、15个字段
+    const char* p = strrchr(stat, ')');
+    unsigned long long utime = 0, stime = 0;
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return 0;
+    }
+    return (utime + stime) * 1000000 / sysconf(_SC_CLK_TCK);
+}
+
+// 从/proc/<pid>/status读取进程的常驻内存（字节），读取失败返回0
+static uint64_t ProcessRssBytes(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[256];
+    unsigned long long kb = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return kb * 1024;
+}
+
+// 风暴模式的一个并发连接：反复连接、握手、断开，直到deadline
+static void StormWorker(const LoadOptions& options, uint64_t deadline, StormLevel& level) {
+    while (NowNs() < deadline) {
+        uint64_t start = NowNs();
+        bool ok;
+        {
+            CTcpSocket socket;
+            socket.SetQuiet(true);
+            socket.SetSessionResumption(false);
+            socket.SetIoTimeout(options.timeout_ms);
+            ok = socket.ConnectToServer(options.address.c_str(), options.port) && socket.EstablishSecureClient();
+        }
+        uint64_t elapsed = NowNs() - start;
+        if (ok) {
+            level.completed++;
+            level.latency.Record(elapsed / 1000);
+        } else if (elapsed >= (uint64_t)options.timeout_ms * 1000000) {
+            level.timeouts++;     // 超时的收发以失败返回，按耗时区分超时与其他失败
+        } else {
+            level.failures++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));   // 连接被拒绝时避免空转
+        }
+    }
+}
+
+// 握手风暴：并发数逐级翻倍，吞吐量连续两级没有增长时停止
+static void RunStorm(const LoadOptions& options) {
+    if (!options.json) {
+        printf("%6s %10s %8s %6s %6s %10s %10s %10s %12s %12s\n", "并发", "握手/秒", "成功", "失败", "超时",
+               "p50(us)", "p99(us)", "p999(us)", "客户端CPU/次", "服务端CPU/次");
+    }
+
+    double best_rate = 0;
+    int best_concurrency = 0;
+    int stalled = 0;
+    for (int concurrency = 1; ; concurrency = std::min(concurrency * 2, options.sessions)) {
+        StormLevel level;
+        uint64_t client_cpu = SelfCpuUs();
+        uint64_t server_cpu = options.server_pid ? ProcessCpuUs(options.server_pid) : 0;
+        uint64_t start = NowNs();
+        uint64_t deadline = start + (uint64_t)options.duration * 1000000000ULL;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < concurrency; i++) {
+            workers.push_back(std::thread(StormWorker, std::cref(options), deadline, std::ref(level)));
+        }
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+        double seconds = (NowNs() - start) / 1e9;
+        client_cpu = SelfCpuUs() - client_cpu;
+        server_cpu = options.server_pid ? ProcessCpuUs(options.server_pid) - server_cpu : 0;
+
+        uint64_t completed = level.completed;
+        HistogramSnapshot latency = level.latency.Snapshot();
+        double rate = completed / seconds;
+        double client_per = completed ? (double)client_cpu / completed : 0;
+        double server_per = completed && options.server_pid ? (double)server_cpu / completed : 0;
+        if (options.json) {
+            printf("{\"concurrency\":%d,\"handshakes_per_s\":%.1f,\"completed\":%llu,\"failures\":%llu,"
+                   "\"timeouts\":%llu,\"latency_p50_us\":%llu,\"latency_p99_us\":%llu,\"latency_p999_us\":%llu,"
+                   "\"latency_max_us\":%llu,\"client_cpu_us\":%.1f,\"server_cpu_us\":%.1f}\n",
+                   concurrency, rate, (unsigned long long)completed, (unsigned long long)level.failures.load(),
+                   (unsigned long long)level.timeouts.load(), (unsigned long long)latency.Percentile(0.5),
+                   (unsigned long long)latency.Percentile(0.99), (unsigned long long)latency.Percentile(0.999),
+                   (unsigned long long)latency.max, client_per, server_per);
+        } else {
+            printf("%6d %10.1f %8llu %6llu %6llu %10llu %10llu %10llu %12.1f %12s\n", concurrency, rate,
+                   (unsigned long long)completed, (unsigned long long)level.failures.load(),
+                   (unsigned long long)level.timeouts.load(), (unsigned long long)latency.Percentile(0.5),
+                   (unsigned long long)latency.Percentile(0.99), (unsigned long long)latency.Percentile(0.999),
+                   client_per, options.server_pid ? std::to_string((long long)server_per).c_str() : "-");
+        }
+        fflush(stdout);
+
+        if (rate >= best_rate * STORM_MIN_GAIN) {
+            best_rate = rate;
+            best_concurrency = concurrency;
+            stalled = 0;
+        } else if (++stalled >= 2) {
+            break;
+        }
+        if (concurrency >= options.sessions) {
+            break;
+        }
+    }
+    if (!options.json) {
+        printf("峰值: 并发 %d 时 %.1f 次握手/秒%s\n", best_concurrency, best_rate,
+               stalled >= 2 ? "，之后已饱和" : "");
+    }
+}
+
+// 空闲连接模式的一个建立线程：依次建立连接，握手完成后只保留描述符
+static void IdleWorker(const LoadOptions& options, int count, std::vector<int>& fds, std::mutex& mutex,
+                       std::atomic<int>& failures) {
+    for (int i = 0; i < count; i++) {
+        CTcpSocket socket;
+        socket.SetQuiet(true);
+        socket.SetSessionResumption(false);
+        socket.SetIoTimeout(options.timeout_ms);
+        if (!socket.ConnectToServer(options.address.c_str(), options.port) || !socket.EstablishSecureClient()) {
+            failures++;
+            continue;
+        }
+        int fd = socket.DetachClient();
+        std::lock_guard<std::mutex> lock(mutex);
+        fds.push_back(fd);
+    }
+}
+
+// 空闲连接：建立-n个连接后保持-d秒，比较建立前后服务器的常驻内存
+static void RunIdle(const LoadOptions& options) {
+    // 每个连接占用一个描述符，把上限提高到硬上限
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    uint64_t rss_before = options.server_pid ? ProcessRssBytes(options.server_pid) : 0;
+    std::vector<int> fds;
+    std::mutex mutex;
+    std::atomic<int> failures(0);
+    uint64_t start = NowNs();
+    std::vector<std::thread> workers;
+    int worker_count = std::min(options.sessions, IDLE_WORKERS);
+    for (int i = 0; i < worker_count; i++) {
+        int count = options.sessions / worker_count + (i < options.sessions % worker_count ? 1 : 0);
+        workers.push_back(std::thread(IdleWorker, std::cref(options), count, std::ref(fds), std::ref(mutex),
+                                      std::ref(failures)));
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    double seconds = (NowNs() - start) / 1e9;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_SETTLE_MS));
+    uint64_t rss_after = options.server_pid ? ProcessRssBytes(options.server_pid) : 0;
+    int established = fds.size();
+    double per_conn = established && rss_after > rss_before ? (double)(rss_after - rss_before) / established : 0;
+
+    if (options.json) {
+        printf("{\"connections\":%d,\"failures\":%d,\"setup_s\":%.2f,\"server_rss_before\":%llu,"
+               "\"server_rss_after\":%llu,\"server_bytes_per_conn\":%.1f,\"conn_hot_bytes\":%zu,"
+               "\"conn_cold_bytes\":%zu,\"session_crypto_bytes\":%zu,\"tcp_socket_bytes\":%zu}\n",
+               established, failures.load(), seconds, (unsigned long long)rss_before,
+               (unsigned long long)rss_after, per_conn, sizeof(ConnHot), sizeof(ConnCold),
+               sizeof(SessionCrypto), sizeof(CTcpSocket));
+    } else {
+        printf("空闲连接: %d 个，失败 %d，建立耗时 %.2f 秒\n", established, failures.load(), seconds);
+        if (options.server_pid) {
+            printf("服务器常驻内存: %.1f MB -> %.1f MB，每连接 %.0f 字节\n", rss_before / 1048576.0,
+                   rss_after / 1048576.0, per_conn);
+        }
+        printf("会话记录: 热数据 %zu 字节 + 冷数据 %zu 字节 + 密钥编排 %zu 字节（CTcpSocket对象 %zu 字节）\n",
+               sizeof(ConnHot), sizeof(ConnCold), sizeof(SessionCrypto), sizeof(CTcpSocket));
+    }
+    fflush(stdout);
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+    for (size_t i = 0; i < fds.size(); i++) {
+        close(fds[i]);
+    }
+}
+
+static void PrintReport(const LoadOptions& options, const std::vector<SessionResult>& results,
+                        MetricHistogram& handshake_latency, uint64_t elapsed_ns) {
+    int connected = 0, handshakes = 0;
+    uint64_t sent = 0, bytes = 0, bulk_bytes = 0, last_handshake_ns = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        connected += results[i].connected;
+        handshakes += results[i].handshake_ok;
+        sent += results[i].sent;
+        bytes += results[i].bytes;
+        bulk_bytes += results[i].bulk_bytes;
+        if (results[i].handshake_done_ns > last_handshake_ns) {
+            last_handshake_ns = results[i].handshake_done_ns;
+        }
+    }
+
+    HistogramSnapshot handshake = handshake_latency.Snapshot();
+    HistogramSnapshot rtt = PingRttHistogram().Snapshot();
+    double handshake_rate = last_handshake_ns ? handshakes / (last_handshake_ns / 1e9) : 0;
+    double seconds = options.duration > 0 ? options.duration : 1;
+    double msg_rate = rtt.count / seconds;
+    double mb_rate = bytes / seconds / (1024 * 1024);
+    double bulk_rate = bulk_bytes / seconds / (1024 * 1024);
+
+    if (options.json) {
+        printf("{\"sessions\":%d,\"connected\":%d,\"handshakes\":%d,\"handshakes_per_s\":%.1f,"
+               "\"handshake_p50_us\":%llu,\"handshake_p99_us\":%llu,"
+               "\"sent\":%llu,\"echoed\":%llu,\"msgs_per_s\":%.1f,\"mb_per_s\":%.3f,"
+               "\"latency_p50_us\":%.1f,\"latency_p99_us\":%.1f,\"latency_p999_us\":%.1f,\"latency_max_us\":%.1f,"
+               "\"bulk_chunk\":%d,\"bulk_mb_per_s\":%.3f,\"elapsed_s\":%.2f}\n",
+               options.sessions, connected, handshakes, handshake_rate,
+               (unsigned long long)handshake.Percentile(0.5), (unsigned long long)handshake.Percentile(0.99),
+               (unsigned long long)sent, (unsigned long long)rtt.count, msg_rate, mb_rate,
+               rtt.Percentile(0.5) / 1000.0, rtt.Percentile(0.99) / 1000.0, rtt.Percentile(0.999) / 1000.0,
+               rtt.max / 1000.0, options.bulk_chunk, bulk_rate, elapsed_ns / 1e9);
+        return;
+    }
+
+    printf("会话: %d 个，连接成功 %d，握手成功 %d\n", options.sessions, connected, handshakes);
+    printf("握手: %.1f 次/秒，耗时 p50 %llu us，p99 %llu us，最大 %llu us\n", handshake_rate,
+           (unsigned long long)handshake.Percentile(0.5), (unsigned long long)handshake.Percentile(0.99),
+           (unsigned long long)handshake.max);
+    printf("消息: 发送 %llu，收到应答 %llu（%.1f%%），%.1f 条/秒，%.3f MB/s\n",
+           (unsigned long long)sent, (unsigned long long)rtt.count, sent ? 100.0 * rtt.count / sent : 0.0,
+           msg_rate, mb_rate);
+    printf("投递延迟（往返）: p50 %.1f us，p99 %.1f us，p999 %.1f us，最大 %.1f us\n",
+           rtt.Percentile(0.5) / 1000.0, rtt.Percentile(0.99) / 1000.0, rtt.Percentile(0.999) / 1000.0,
+           rtt.max / 1000.0);
+    if (options.bulk_chunk > 0) {
+        HistogramSnapshot wait = LaneWaitHistogram(LANE_CONTROL).Snapshot();
+        printf("批量数据: 块大小 %d 字节，%.3f MB/s\n", options.bulk_chunk, bulk_rate);
+        printf("探测帧等待发送通道: p50 %.1f us，p99 %.1f us，最大 %.1f us\n", wait.Percentile(0.5) / 1000.0,
+               wait.Percentile(0.99) / 1000.0, wait.max / 1000.0);
+    }
+}
+
+static void Usage(const char* program) {
+    fprintf(stderr, "用法: %s [-a 地址] [-p 端口] [-n 会话数] [-r 每会话每秒消息数] [-s 长度分布] [-d 秒数] [--json]\n"
+                    "      %s --storm [-n 最大并发数] [-d 每级秒数] [-t 超时毫秒] [--server-pid 进程号] [--json]\n"
+                    "      %s --idle [-n 连接数] [-d 保持秒数] [--server-pid 进程号] [--json]\n"
+                    "      %s --bulk 块大小 [-n 会话数] [-r 每会话每秒消息数] [-s 长度分布] [-d 秒数] [--json]\n",
+            program, program, program, program);
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    options.address = "127.0.0.1";
+    options.port = DEFAULT_PORT;
+    options.sessions = 10;
+    options.rate = 100;
+    options.duration = 10;
+    options.json = false;
+    options.storm = false;
+    options.idle = false;
+    options.timeout_ms = STORM_TIMEOUT_MS;
+    options.server_pid = 0;
+    options.bulk_chunk = 0;
+    ParseSizes("64", options.sizes);
+
+    static struct option long_options[] = {
+        {"json", no_argument, NULL, 'j'},
+        {"storm", no_argument, NULL, 'S'},
+        {"idle", no_argument, NULL, 'I'},
+        {"server-pid", required_argument, NULL, 'P'},
+        {"bulk", required_argument, NULL, 'B'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "a:p:n:r:s:d:t:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'a': options.address = optarg; break;
+        case 'p': options.port = atoi(optarg); break;
+        case 'n': options.sessions = atoi(optarg); break;
+        case 'r': options.rate = atof(optarg); break;
+        case 'd': options.duration = atoi(optarg); break;
+        case 'j': options.json = true; break;
+        case 'S': options.storm = true; break;
+        case 'I': options.idle = true; break;
+        case 't': options.timeout_ms = atoi(optarg); break;
+        case 'P': options.server_pid = atoi(optarg); break;
+        case 'B': options.bulk_chunk = atoi(optarg); break;
+        case 's':
+            if (!ParseSizes(optarg, options.sizes)) {
+                fprintf(stderr, "无效的长度分布: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.sessions <= 0 || options.duration <= 0 || options.timeout_ms <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // 握手过程中的提示写到std::cout/std::cerr，压测时关闭；报告用printf输出
+    LOG_INIT("chatload.log", ERROR, WARNING);
+    std::cout.rdbuf(NULL);
+    std::cerr.rdbuf(NULL);
+    if (options.storm) {
+        RunStorm(options);
+        return 0;
+    }
+    if (options.idle) {
+        RunIdle(options);
+        return 0;
+    }
+
+    // 直方图在启动会话线程之前注册一次，各线程共用
+    MetricHistogram& handshake_latency = MetricsRegistry::GetInstance().Histogram(
+        "chatload_handshake_us", "压测客户端握手耗时（微秒）");
+    std::vector<SessionResult> results(options.sessions);
+    std::vector<std::thread> threads;
+    uint64_t start = NowNs();
+    for (int i = 0; i < options.sessions; i++) {
+        threads.push_back(std::thread(RunSession, std::cref(options), i, start, std::ref(handshake_latency),
+                                      std::ref(results[i])));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    PrintReport(options, results, handshake_latency, NowNs() - start);
+    return 0;
+}
@@ -0,0 +1,314 @@
+// 流量回放工具：读取服务器以CHATROOM_CAPTURE记录的捕获文件，按原始时序（或按倍速、最快速度）
+// 重新建立每个连接并发送相同类型与长度的帧，用于在本地用新版本复现线上的性能问题。
+// 消息内容没有被捕获，以固定的填充字节代替；批量数据块按线路长度在批量通道上重发。换钥帧由客户端按
+// 自己的策略产生，探测应答帧是对服务端探测的回应，两者都不回放。票据恢复的会话回放为完整握手。
+// 用法: ./chatreplay [-a 地址] [-p 端口] [-x 倍速] [--json] 捕获文件
+//       ./chatreplay --dump 捕获文件
+//   -x 1   按原始时序（默认）；-x 10 十倍速；-x 0 不等待，尽快发送
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "tcp_socket.h"
+
+#define REPLAY_GRACE_MS 500        // 连接最后一帧发出后等待应答的时间
+
+struct ReplayOptions {
+    std::string address;
+    int port;
+    double speed;                  // 倍速，0表示不等待
+    bool json;
+    bool dump;
+};
+
+// 一个被捕获的连接
+struct ReplayConnection {
+    uint32_t id;
+    uint64_t open_ns;
+    uint64_t close_ns;
+    bool resumed;
+    int early_size;                        // 0-RTT消息长度，-1表示没有
+    std::vector<CaptureRecord> frames;     // 需要回放的帧
+};
+
+// 回放统计（所有连接共用）
+struct ReplayStats {
+    std::atomic<uint64_t> connected;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> bytes;
+    MetricHistogram handshake_us;          // 握手耗时
+    MetricHistogram lag_us;                // 实际发送时间落后于计划的时间
+
+    ReplayStats() : connected(0), failed(0), frames(0), bytes(0) {}
+};
+
+static uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* EventName(uint8_t event) {
+    switch (event) {
+    case CAPTURE_OPEN: return "open";
+    case CAPTURE_FRAME: return "frame";
+    case CAPTURE_CLOSE: return "close";
+    default: return "unknown";
+    }
+}
+
+static bool ReadCapture(const char* path, CaptureFileHeader& header, std::vector<CaptureRecord>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "无法打开文件: %s\n", path);
+        return false;
+    }
+    if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: 不是捕获文件\n", path);
+        return false;
+    }
+    CaptureRecord record;
+    while (in.read((char*)&record, sizeof(record))) {
+        records.push_back(record);
+    }
+    if (in.gcount() != 0) {
+        fprintf(stderr, "%s: 最后一条记录不完整，已忽略\n", path);
+    }
+    return true;
+}
+
+// 按连接整理记录；进程被终止时没有CLOSE记录的连接以最后一帧为结束时间
+static std::vector<ReplayConnection> GroupConnections(const std::vector<CaptureRecord>& records) {
+    std::map<uint32_t, ReplayConnection> by_id;
+    for (size_t i = 0; i < records.size(); i++) {
+        const CaptureRecord& record = records[i];
+        ReplayConnection& conn = by_id[record.conn_id];
+        if (record.event == CAPTURE_OPEN) {
+            conn.id = record.conn_id;
+            conn.open_ns = record.offset_ns;
+            conn.close_ns = record.offset_ns;
+            conn.resumed = (record.flags & CAPTURE_FLAG_RESUMED) != 0;
+            conn.early_size = -1;
+        } else if (record.event == CAPTURE_FRAME) {
+            conn.close_ns = record.offset_ns;
+            if (record.flags & CAPTURE_FLAG_EARLY) {
+                conn.early_size = record.size;
+            } else if (record.type == FRAME_CHAT || record.type == FRAME_PING || record.type == FRAME_BULK) {
+                conn.frames.push_back(record);
+            }
+        } else if (record.event == CAPTURE_CLOSE) {
+            conn.close_ns = record.offset_ns;
+        }
+    }
+
+    std::vector<ReplayConnection> connections;
+    for (std::map<uint32_t, ReplayConnection>::iterator it = by_id.begin(); it != by_id.end(); ++it) {
+        if (it->second.id != 0) {
+            connections.push_back(it->second);     // 没有OPEN记录的连接（捕获开始前建立）无法回放
+        }
+    }
+    return connections;
+}
+
+static void Dump(const CaptureFileHeader& header, const std::vector<CaptureRecord>& records) {
+    printf("# 开始时间 %llu ns（实时时钟），%zu 条记录\n", (unsigned long long)header.start_real_ns, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const CaptureRecord& record = records[i];
+        printf("%14.6f conn=%u %-5s", record.offset_ns / 1e9, record.conn_id, EventName(record.event));
+        if (record.event == CAPTURE_OPEN) {
+            printf(" %s", (record.flags & CAPTURE_FLAG_RESUMED) ? "resumed" : "full");
+        } else if (record.event == CAPTURE_FRAME) {
+            printf(" type=%u size=%u wire=%u%s", record.type, record.size, record.wire_size,
+                   (record.flags & CAPTURE_FLAG_EARLY) ? " early" : "");
+        }
+        printf("\n");
+    }
+}
+
+// 在计划时间（相对回放开始，已按倍速换算）之前等待，返回落后于计划的时间
+static uint64_t WaitUntil(const ReplayOptions& options, uint64_t start, uint64_t offset_ns) {
+    if (options.speed <= 0) {
+        return 0;
+    }
+    uint64_t target = start + (uint64_t)(offset_ns / options.speed);
+    uint64_t now = NowNs();
+    if (target > now) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(target - now));
+        return 0;
+    }
+    return now - target;
+}
+
+// 批量数据块的数据长度：线路长度减去帧头与块头（密文的零填充不超过7字节，忽略）
+static int BulkDataSize(const CaptureRecord& frame) {
+    int size = (int)frame.wire_size - (int)sizeof(FrameHeader) - (int)sizeof(BulkChunkHeader);
+    return std::max(1, std::min(size, BULK_CHUNK_MAX));
+}
+
+static void ReplayOne(const ReplayOptions& options, const ReplayConnection& conn, uint64_t start, ReplayStats& stats) {
+    static const std::string filler(BULK_CHUNK_MAX, 'x');
+
+    CTcpSocket socket;
+    socket.SetQuiet(true);
+    socket.SetSessionResumption(false);
+    socket.SetBulkChunkSize(BULK_CHUNK_MAX);     // 每个捕获的块重发为一个块帧
+    if (conn.early_size >= 0) {
+        socket.SetEarlyData(filler.data(), std::min(conn.early_size, BUFFER_SIZE - 1));
+    }
+    MetricStopwatch timer;
+    if (!socket.ConnectToServer(options.address.c_str(), options.port) || !socket.EstablishSecureClient()) {
+        stats.failed++;
+        return;
+    }
+    stats.handshake_us.Record(timer.ElapsedUs());
+    stats.connected++;
+
+    // 接收线程读走服务器转发的消息与探测应答，避免服务器的发送阻塞
+    std::atomic<bool> stop(false);
+    std::thread receiver([&socket, &stop]() { socket.ReceiveLoop(stop); });
+
+    uint64_t bulk_offset = 0;
+    for (size_t i = 0; i < conn.frames.size(); i++) {
+        const CaptureRecord& frame = conn.frames[i];
+        stats.lag_us.Record(WaitUntil(options, start, frame.offset_ns) / 1000);
+        int size;
+        bool ok;
+        if (frame.type == FRAME_BULK) {
+            size = BulkDataSize(frame);
+            ok = socket.SendBulk(1, filler.data(), size, bulk_offset, false);
+            bulk_offset += size;
+        } else {
+            size = std::min((int)frame.size, BUFFER_SIZE - 1);
+            ok = frame.type == FRAME_PING ? socket.SendPing(size) : socket.SendChatMessage(filler.data(), size);
+        }
+        if (!ok) {
+            break;
+        }
+        stats.frames++;
+        stats.bytes += size;
+    }
+
+    WaitUntil(options, start, conn.close_ns);
+    std::this_thread::sleep_for(std::chrono::milliseconds(REPLAY_GRACE_MS));
+    stop = true;
+    socket.ShutdownConnection();
+    receiver.join();
+}
+
+static void Report(const ReplayOptions& options, const std::vector<ReplayConnection>& connections,
+                   ReplayStats& stats, uint64_t elapsed_ns) {
+    HistogramSnapshot handshake = stats.handshake_us.Snapshot();
+    HistogramSnapshot lag = stats.lag_us.Snapshot();
+    HistogramSnapshot rtt = PingRttHistogram().Snapshot();
+    double seconds = elapsed_ns / 1e9;
+
+    if (options.json) {
+        printf("{\"connections\":%zu,\"connected\":%llu,\"failed\":%llu,\"frames\":%llu,\"frames_per_s\":%.1f,"
+               "\"mb_per_s\":%.3f,\"handshake_p50_us\":%llu,\"handshake_p99_us\":%llu,\"lag_p99_us\":%llu,"
+               "\"lag_max_us\":%llu,\"ping_rtt_p50_us\":%.1f,\"ping_rtt_p99_us\":%.1f,\"elapsed_s\":%.2f}\n",
+               connections.size(), (unsigned long long)stats.connected.load(), (unsigned long long)stats.failed.load(),
+               (unsigned long long)stats.frames.load(), stats.frames / seconds,
+               stats.bytes / seconds / (1024 * 1024), (unsigned long long)handshake.Percentile(0.5),
+               (unsigned long long)handshake.Percentile(0.99), (unsigned long long)lag.Percentile(0.99),
+               (unsigned long long)lag.max, rtt.Percentile(0.5) / 1000.0, rtt.Percentile(0.99) / 1000.0, seconds);
+        return;
+    }
+
+    printf("连接: 捕获 %zu 个，回放成功 %llu，失败 %llu\n", connections.size(),
+           (unsigned long long)stats.connected.load(), (unsigned long long)stats.failed.load());
+    printf("握手: 耗时 p50 %llu us，p99 %llu us\n",
+           (unsigned long long)handshake.Percentile(0.5), (unsigned long long)handshake.Percentile(0.99));
+    printf("帧: 发送 %llu，%.1f 帧/秒，%.3f MB/s，用时 %.2f 秒\n", (unsigned long long)stats.frames.load(),
+           stats.frames / seconds, stats.bytes / seconds / (1024 * 1024), seconds);
+    if (options.speed > 0) {
+        printf("发送落后于计划: p99 %llu us，最大 %llu us\n",
+               (unsigned long long)lag.Percentile(0.99), (unsigned long long)lag.max);
+    }
+    if (rtt.count > 0) {
+        printf("探测往返延迟: 样本 %llu，p50 %.1f us，p99 %.1f us，最大 %.1f us\n", (unsigned long long)rtt.count,
+               rtt.Percentile(0.5) / 1000.0, rtt.Percentile(0.99) / 1000.0, rtt.max / 1000.0);
+    }
+}
+
+static void Usage(const char* program) {
+    fprintf(stderr, "用法: %s [-a 地址] [-p 端口] [-x 倍速] [--json] 捕获文件\n"
+                    "      %s --dump 捕获文件\n", program, program);
+}
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options;
+    options.address = "127.0.0.1";
+    options.port = DEFAULT_PORT;
+    options.speed = 1;
+    options.json = false;
+    options.dump = false;
+
+    static struct option long_options[] = {
+        {"json", no_argument, NULL, 'j'},
+        {"dump", no_argument, NULL, 'D'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "a:p:x:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'a': options.address = optarg; break;
+        case 'p': options.port = atoi(optarg); break;
+        case 'x': options.speed = atof(optarg); break;
+        case 'j': options.json = true; break;
+        case 'D': options.dump = true; break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || options.speed < 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    CaptureFileHeader header;
+    std::vector<CaptureRecord> records;
+    if (!ReadCapture(argv[optind], header, records)) {
+        return 1;
+    }
+    if (options.dump) {
+        Dump(header, records);
+        return 0;
+    }
+
+    // 握手过程中的提示写到std::cout/std::cerr，回放时关闭；报告用printf输出
+    LOG_INIT("chatreplay.log", ERROR, WARNING);
+    std::cout.rdbuf(NULL);
+    std::cerr.rdbuf(NULL);
+
+    // 每个连接一个线程，按捕获中的建立时间依次启动
+    std::vector<ReplayConnection> connections = GroupConnections(records);
+    uint64_t base = connections.empty() ? 0 : connections[0].open_ns;    // 从第一个连接开始回放
+    for (size_t i = 0; i < connections.size(); i++) {
+        connections[i].open_ns -= base;
+        connections[i].close_ns -= base;
+        for (size_t j = 0; j < connections[i].frames.size(); j++) {
+            connections[i].frames[j].offset_ns -= base;
+        }
+    }
+    ReplayStats stats;
+    std::vector<std::thread> threads;
+    uint64_t start = NowNs();
+    for (size_t i = 0; i < connections.size(); i++) {
+        WaitUntil(options, start, connections[i].open_ns);
+        threads.push_back(std::thread(ReplayOne, std::cref(options), std::cref(connections[i]), start, std::ref(stats)));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    Report(options, connections, stats, NowNs() - start);
+    return 0;
+}
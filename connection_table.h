@@ -0,0 +1,125 @@
+#ifndef CONNECTION_TABLE_H
+#define CONNECTION_TABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <vector>
+
+#include "session_keys.h"
+
+// 连接状态
+enum ConnState {
+    CONN_FREE = 0,         // 槽位空闲
+    CONN_ESTABLISHED = 1,  // 握手已完成，由事件循环收发
+    CONN_CLOSING = 2       // 等待发送缓冲清空后关闭
+};
+
+#define CONN_FLAG_THROTTLED 0x01   // 超过速率限制，暂停读取
+
+// 一个会话两个方向的密钥编排（约560字节），握手完成时分配，连接关闭时释放
+struct SessionCrypto {
+    SessionKeyRing send_keys;
+    SessionKeyRing recv_keys;
+};
+
+// 热数据：每次收发都要访问的字段，正好一个缓存行。
+// 空闲连接不持有任何缓冲区：只有收到半帧或发送被阻塞时才从缓冲池借用
+struct ConnHot {
+    int32_t fd;
+    uint8_t state;             // ConnState
+    uint8_t flags;             // CONN_FLAG_*
+    uint8_t reserved[2];
+    uint32_t send_seq;         // 下一帧的发送序号
+    uint32_t rx_len;           // rx_buf中暂存的字节数
+    int32_t deficit;           // 差额轮询：本连接累积的可读取字节数
+    uint32_t tx_len;           // tx_buf中待发送的字节数
+    uint32_t tx_off;           // tx_buf中已发送的字节数
+    uint32_t tx_cap;
+    char* rx_buf;              // 不完整的帧或限速时暂缓处理的帧（来自缓冲池），没有时为NULL
+    char* tx_buf;              // 内核发送缓冲已满时排队的数据（来自缓冲池），没有时为NULL
+    SessionCrypto* crypto;     // 密钥编排
+    uint64_t last_active_ns;   // 最近一次收到数据的时间
+};
+
+// 冷数据：不参与转发遍历，只在处理本连接的收发、换钥与定时器时访问
+struct ConnCold {
+    struct sockaddr_in peer;   // 对端地址
+    uint32_t capture_id;       // 流量捕获中的连接编号
+    uint32_t reserved;
+    uint64_t established_ns;   // 握手完成时间
+    uint64_t frames_in;
+    uint64_t frames_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t bytes_since_rekey;  // 上次发送方向换钥后已发送的字节数
+    time_t last_rekey;           // 上次发送方向换钥时间
+    uint64_t last_sent_ns;       // 最近一次发送帧的时间（含心跳与转发的消息）
+    uint64_t bucket_ns;          // 令牌桶上次补充令牌的时间
+    float msg_tokens;            // 可用的消息令牌
+    float byte_tokens;           // 可用的字节令牌
+};
+
+static_assert(sizeof(ConnHot) == 64, "ConnHot应正好占一个缓存行");
+
+// 按描述符索引的连接槽位表
+// 热数据与冷数据分别存放在两个连续数组中，遍历或查找热数据时不会把冷数据带入缓存；
+// 描述符由内核从小到大复用，数组保持稠密。只由事件循环线程访问，不加锁。
+class ConnectionTable {
+public:
+    ConnectionTable() : m_count(0) {}
+
+    // 为fd占用槽位并清零，返回热数据
+    ConnHot& Insert(int fd) {
+        if (fd >= (int)m_hot.size()) {
+            size_t size = m_hot.empty() ? 1024 : m_hot.size();
+            while (size <= (size_t)fd) {
+                size *= 2;
+            }
+            m_hot.resize(size);
+            m_cold.resize(size);
+        }
+        ConnHot& hot = m_hot[fd];
+        memset(&hot, 0, sizeof(hot));
+        memset(&m_cold[fd], 0, sizeof(ConnCold));
+        hot.fd = fd;
+        hot.state = CONN_ESTABLISHED;
+        m_count++;
+        return hot;
+    }
+
+    // 释放槽位；调用方负责先归还缓冲区与密钥
+    void Remove(int fd) {
+        if (Find(fd) != NULL) {
+            m_hot[fd].state = CONN_FREE;
+            m_count--;
+        }
+    }
+
+    ConnHot* Find(int fd) {
+        if (fd < 0 || fd >= (int)m_hot.size() || m_hot[fd].state == CONN_FREE) {
+            return NULL;
+        }
+        return &m_hot[fd];
+    }
+
+    ConnCold& Cold(int fd) { return m_cold[fd]; }
+
+    // 槽位数（最大描述符加一，按2的幂增长），用于遍历
+    int Capacity() const { return (int)m_hot.size(); }
+    ConnHot& At(int index) { return m_hot[index]; }
+    int Count() const { return m_count; }
+
+    // 槽位表本身占用的内存（不含按需借用的缓冲区与密钥编排）
+    size_t TableBytes() const {
+        return m_hot.capacity() * sizeof(ConnHot) + m_cold.capacity() * sizeof(ConnCold);
+    }
+
+private:
+    std::vector<ConnHot> m_hot;
+    std::vector<ConnCold> m_cold;
+    int m_count;               // 使用中的槽位数
+};
+
+#endif // CONNECTION_TABLE_H
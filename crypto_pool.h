@@ -0,0 +1,164 @@
+#ifndef CRYPTO_POOL_H
+#define CRYPTO_POOL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define CRYPTO_POOL_THREADS 2   // 默认工作线程数
+
+// 加密线程池统计信息
+struct CryptoPoolStats {
+    uint64_t submitted;        // 已提交任务数
+    uint64_t completed;        // 已完成任务数
+    size_t queue_depth;        // 当前排队任务数
+    size_t peak_depth;         // 历史最大排队任务数
+    uint64_t total_wait_ns;    // 累计排队等待时间
+    uint64_t total_run_ns;     // 累计执行时间
+    uint64_t max_latency_ns;   // 单个任务最大延迟（等待+执行）
+
+    // 平均单任务延迟（微秒）
+    double AvgLatencyUs() const {
+        return completed == 0 ? 0.0 : (total_wait_ns + total_run_ns) / 1000.0 / completed;
+    }
+};
+
+// 加密工作线程池
+// 握手中的RSA密钥生成、私钥解密等CPU密集操作提交到这里执行，线程数限制了同时进行的CPU密集计算。
+// 提交任务的线程通过返回的future取回结果；握手采用每连接一个线程的模型，等待结果时该线程阻塞。
+class CryptoWorkerPool {
+public:
+    // 获取线程池单例实例
+    static CryptoWorkerPool& GetInstance() {
+        static CryptoWorkerPool instance;
+        return instance;
+    }
+
+    // 启动工作线程，threads为0时使用默认线程数；重复调用无效
+    void Start(int threads = 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_workers.empty()) {
+            return;
+        }
+        if (threads <= 0) {
+            threads = CRYPTO_POOL_THREADS;
+        }
+        m_stopping = false;
+        m_owner_pid = getpid();
+        for (int i = 0; i < threads; i++) {
+            m_workers.push_back(std::thread(&CryptoWorkerPool::WorkerLoop, this));
+        }
+    }
+
+    // 停止线程池，已排队的任务执行完后返回
+    void Stop() {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            workers.swap(m_workers);
+        }
+        m_cond.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            // fork出的子进程中工作线程并不存在，只能分离
+            if (getpid() == m_owner_pid) {
+                workers[i].join();
+            } else {
+                workers[i].detach();
+            }
+        }
+    }
+
+    // 提交任务，结果通过future交回提交任务的连接
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> Submit(F job) {
+        typedef typename std::result_of<F()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()> > task =
+            std::make_shared<std::packaged_task<Result()> >(job);
+        std::future<Result> result = task->get_future();
+
+        Start();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Job entry;
+            entry.run = [task]() { (*task)(); };
+            entry.enqueued = std::chrono::steady_clock::now();
+            m_queue.push_back(entry);
+            m_stats.submitted++;
+            if (m_queue.size() > m_stats.peak_depth) {
+                m_stats.peak_depth = m_queue.size();
+            }
+        }
+        m_cond.notify_one();
+        return result;
+    }
+
+    CryptoPoolStats GetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        CryptoPoolStats stats = m_stats;
+        stats.queue_depth = m_queue.size();
+        return stats;
+    }
+
+private:
+    struct Job {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    CryptoWorkerPool() : m_stopping(false), m_owner_pid(0) {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+    ~CryptoWorkerPool() { Stop(); }
+    // 禁止复制和赋值
+    CryptoWorkerPool(const CryptoWorkerPool&) = delete;
+    CryptoWorkerPool& operator=(const CryptoWorkerPool&) = delete;
+
+    void WorkerLoop() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty()) {
+                    return;
+                }
+                job = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            job.run();
+            std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+            uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(started - job.enqueued).count();
+            uint64_t run_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.completed++;
+            m_stats.total_wait_ns += wait_ns;
+            m_stats.total_run_ns += run_ns;
+            if (wait_ns + run_ns > m_stats.max_latency_ns) {
+                m_stats.max_latency_ns = wait_ns + run_ns;
+            }
+        }
+    }
+
+    std::vector<std::thread> m_workers;   // 工作线程
+    std::deque<Job> m_queue;              // 待执行任务
+    std::mutex m_mutex;                   // 保护队列与统计信息
+    std::condition_variable m_cond;       // 新任务或停止通知
+    bool m_stopping;                      // 是否正在停止
+    pid_t m_owner_pid;                    // 创建工作线程的进程
+    CryptoPoolStats m_stats;              // 统计信息
+};
+
+#endif // CRYPTO_POOL_H
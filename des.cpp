@@ -1,19 +1,43 @@
 #include "des.h"
+#include "metrics.h"
+
+// 记录一次加解密的字节数、耗时与每字节耗时。每字节耗时以皮秒为单位，短消息与低于1纳秒/字节的
+// 大块数据都不会被截断为0；总耗时除以总字节数即为平均每字节耗时
+static void RecordDesMetrics(bool encrypt, uint64_t elapsed_ns, int len) {
+    static MetricHistogram& encrypt_rate = MetricsRegistry::GetInstance().Histogram(
+        "des_encrypt_ps_per_byte", "DES加密每字节耗时（皮秒）");
+    static MetricHistogram& decrypt_rate = MetricsRegistry::GetInstance().Histogram(
+        "des_decrypt_ps_per_byte", "DES解密每字节耗时（皮秒）");
+    static MetricCounter& encrypt_bytes = MetricsRegistry::GetInstance().Counter(
+        "des_encrypt_bytes_total", "DES加密字节数");
+    static MetricCounter& decrypt_bytes = MetricsRegistry::GetInstance().Counter(
+        "des_decrypt_bytes_total", "DES解密字节数");
+    static MetricCounter& encrypt_time = MetricsRegistry::GetInstance().Counter(
+        "des_encrypt_ns_total", "DES加密总耗时（纳秒）");
+    static MetricCounter& decrypt_time = MetricsRegistry::GetInstance().Counter(
+        "des_decrypt_ns_total", "DES解密总耗时（纳秒）");
+    if (len <= 0) {
+        return;
+    }
+    (encrypt ? encrypt_rate : decrypt_rate).Record(elapsed_ns * 1000 / len);
+    (encrypt ? encrypt_bytes : decrypt_bytes).Add(len);
+    (encrypt ? encrypt_time : decrypt_time).Add(elapsed_ns);
+}
 
 // 构造函数
 CDesOperate::CDesOperate() {
     // 初始化子密钥数组
-    memset(m_arrOutKey, 0, sizeof(m_arrOutKey));
+    memset(&m_arrOutKey, 0, sizeof(m_arrOutKey));
 }
 
 // 析构函数
 CDesOperate::~CDesOperate() {
     // 清空子密钥数组，防止密钥泄露
-    memset(m_arrOutKey, 0, sizeof(m_arrOutKey));
+    memset(&m_arrOutKey, 0, sizeof(m_arrOutKey));
 }
 
 // 生成初始密钥
-void CDesOperate::MakeFirstKey(const char* key, int key_len) {
+void CDesOperate::MakeFirstKey(const char* key, int key_len, DesKeySchedule& schedule) {
     // 确保密钥长度至少为8字节
     if (key_len < 8) {
         return;
@@ -47,17 +71,17 @@ void CDesOperate::MakeFirstKey(const char* key, int key_len) {
     }
     
     // 存储初始子密钥
-    m_arrOutKey[0][0] = newLeft;
-    m_arrOutKey[0][1] = newRight;
+    schedule.subkeys[0][0] = newLeft;
+    schedule.subkeys[0][1] = newRight;
 }
 
 // 生成16轮子密钥
-void CDesOperate::MakeKey() {
+void CDesOperate::MakeKey(DesKeySchedule& schedule) {
     // 根据初始子密钥生成16轮子密钥
     for (int i = 1; i < 16; i++) {
         // 循环左移
-        unsigned int left = m_arrOutKey[i-1][0];
-        unsigned int right = m_arrOutKey[i-1][1];
+        unsigned int left = schedule.subkeys[i-1][0];
+        unsigned int right = schedule.subkeys[i-1][1];
         
         // 根据LOOP_Table确定左移位数
         int loop = LOOP_Table[i];
@@ -66,14 +90,14 @@ void CDesOperate::MakeKey() {
         left = ((left << loop) | (left >> (28 - loop))) & 0x0FFFFFFF;
         right = ((right << loop) | (right >> (28 - loop))) & 0x0FFFFFFF;
         
-        m_arrOutKey[i][0] = left;
-        m_arrOutKey[i][1] = right;
+        schedule.subkeys[i][0] = left;
+        schedule.subkeys[i][1] = right;
     }
     
     // 应用PC2置换，生成48位子密钥
     for (int i = 0; i < 16; i++) {
-        unsigned int left = m_arrOutKey[i][0];
-        unsigned int right = m_arrOutKey[i][1];
+        unsigned int left = schedule.subkeys[i][0];
+        unsigned int right = schedule.subkeys[i][1];
         unsigned int newLeft = 0, newRight = 0;
         
         // 应用PC2置换
@@ -95,8 +119,8 @@ void CDesOperate::MakeKey() {
             }
         }
         
-        m_arrOutKey[i][0] = newLeft;
-        m_arrOutKey[i][1] = newRight;
+        schedule.subkeys[i][0] = newLeft;
+        schedule.subkeys[i][1] = newRight;
     }
 }
 
@@ -140,7 +164,7 @@ unsigned int CDesOperate::F(unsigned int r, unsigned int k0, unsigned int k1) {
 }
 
 // 加密单个64位块
-void CDesOperate::EncryBlock(unsigned int& left, unsigned int& right) {
+void CDesOperate::EncryBlock(unsigned int& left, unsigned int& right, const DesKeySchedule& schedule) {
     // 初始置换IP
     unsigned int newLeft = 0, newRight = 0;
     unsigned int oldLeft = left, oldRight = right;
@@ -169,7 +193,7 @@ void CDesOperate::EncryBlock(unsigned int& left, unsigned int& right) {
     // 16轮Feistel网络
     for (int i = 0; i < 16; i++) {
         unsigned int temp = right;
-        right = left ^ F(right, m_arrOutKey[i][0], m_arrOutKey[i][1]);
+        right = left ^ F(right, schedule.subkeys[i][0], schedule.subkeys[i][1]);
         left = temp;
     }
     
@@ -207,7 +231,7 @@ void CDesOperate::EncryBlock(unsigned int& left, unsigned int& right) {
 }
 
 // 解密单个64位块
-void CDesOperate::DecryBlock(unsigned int& left, unsigned int& right) {
+void CDesOperate::DecryBlock(unsigned int& left, unsigned int& right, const DesKeySchedule& schedule) {
     // 初始置换IP
     unsigned int newLeft = 0, newRight = 0;
     unsigned int oldLeft = left, oldRight = right;
@@ -236,7 +260,7 @@ void CDesOperate::DecryBlock(unsigned int& left, unsigned int& right) {
     // 16轮Feistel网络，注意子密钥顺序与加密相反
     for (int i = 15; i >= 0; i--) {
         unsigned int temp = right;
-        right = left ^ F(right, m_arrOutKey[i][0], m_arrOutKey[i][1]);
+        right = left ^ F(right, schedule.subkeys[i][0], schedule.subkeys[i][1]);
         left = temp;
     }
     
@@ -273,6 +297,16 @@ void CDesOperate::DecryBlock(unsigned int& left, unsigned int& right) {
     right = newRight;
 }
 
+// 展开密钥，生成16轮子密钥
+bool CDesOperate::ExpandKey(const char* key, int key_len, DesKeySchedule& schedule) {
+    if (key == NULL || key_len < 8) {
+        return false;
+    }
+    MakeFirstKey(key, key_len, schedule);
+    MakeKey(schedule);
+    return true;
+}
+
 // 加密函数
 bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* ciphertext, int& ciphertext_len, const char* key, int key_len) {
     if (plaintext == NULL || ciphertext == NULL || key == NULL) {
@@ -280,8 +314,17 @@ bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* cipherte
     }
     
     // 生成子密钥
-    MakeFirstKey(key, key_len);
-    MakeKey();
+    MakeFirstKey(key, key_len, m_arrOutKey);
+    MakeKey(m_arrOutKey);
+    
+    return Encry(plaintext, plaintext_len, ciphertext, ciphertext_len, m_arrOutKey);
+}
+
+// 使用预先展开的密钥编排加密
+bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* ciphertext, int& ciphertext_len, const DesKeySchedule& schedule) const {
+    if (plaintext == NULL || ciphertext == NULL) {
+        return false;
+    }
     
     // 计算需要的缓冲区大小
     int blockCount = (plaintext_len + 7) / 8; // 向上取整到8字节的倍数
@@ -290,6 +333,7 @@ bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* cipherte
     if (ciphertext_len < bufferSize) {
         return false; // 输出缓冲区不足
     }
+    MetricStopwatch timer;
     
     // 设置实际输出长度
     ciphertext_len = bufferSize;
@@ -314,7 +358,7 @@ bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* cipherte
         }
         
         // 加密单个块
-        EncryBlock(left, right);
+        EncryBlock(left, right, schedule);
         
         // 将加密结果写入输出缓冲区
         for (int j = 0; j < 4; j++) {
@@ -323,6 +367,7 @@ bool CDesOperate::Encry(const char* plaintext, int plaintext_len, char* cipherte
         }
     }
     
+    RecordDesMetrics(true, timer.ElapsedNs(), bufferSize);
     return true;
 }
 
@@ -338,8 +383,22 @@ bool CDesOperate::Decry(const char* ciphertext, int ciphertext_len, char* plaint
     }
     
     // 生成子密钥
-    MakeFirstKey(key, key_len);
-    MakeKey();
+    MakeFirstKey(key, key_len, m_arrOutKey);
+    MakeKey(m_arrOutKey);
+    
+    return Decry(ciphertext, ciphertext_len, plaintext, plaintext_len, m_arrOutKey);
+}
+
+// 使用预先展开的密钥编排解密
+bool CDesOperate::Decry(const char* ciphertext, int ciphertext_len, char* plaintext, int& plaintext_len, const DesKeySchedule& schedule) const {
+    if (ciphertext == NULL || plaintext == NULL) {
+        return false;
+    }
+    
+    // 密文长度必须是8的倍数
+    if (ciphertext_len % 8 != 0) {
+        return false;
+    }
     
     // 检查输出缓冲区大小
     if (plaintext_len < ciphertext_len) {
@@ -348,6 +407,7 @@ bool CDesOperate::Decry(const char* ciphertext, int ciphertext_len, char* plaint
     
     // 设置实际输出长度
     plaintext_len = ciphertext_len;
+    MetricStopwatch timer;
     
     // 按8字节(64位)分组解密
     int blockCount = ciphertext_len / 8;
@@ -361,7 +421,7 @@ bool CDesOperate::Decry(const char* ciphertext, int ciphertext_len, char* plaint
         }
         
         // 解密单个块
-        DecryBlock(left, right);
+        DecryBlock(left, right, schedule);
         
         // 将解密结果写入输出缓冲区
         for (int j = 0; j < 4; j++) {
@@ -370,5 +430,6 @@ bool CDesOperate::Decry(const char* ciphertext, int ciphertext_len, char* plaint
         }
     }
     
+    RecordDesMetrics(false, timer.ElapsedNs(), ciphertext_len);
     return true;
 }
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// 展开后的16轮子密钥，可预先计算并在多次加解密中复用
+struct DesKeySchedule {
+    unsigned int subkeys[16][2];
+};
+
 // DES加密模块类
 class CDesOperate {
 public:
@@ -29,24 +34,35 @@ public:
     // key_len: 密钥长度
     bool Decry(const char* ciphertext, int ciphertext_len, char* plaintext, int& plaintext_len, const char* key, int key_len);
 
+    // 展开密钥，生成16轮子密钥
+    // key: 密钥
+    // key_len: 密钥长度（至少8字节）
+    // schedule: 输出的密钥编排
+    static bool ExpandKey(const char* key, int key_len, DesKeySchedule& schedule);
+
+    // 使用预先展开的密钥编排加密/解密，省去每次调用的密钥展开；
+    // 不修改对象状态，可在多个线程中同时调用
+    bool Encry(const char* plaintext, int plaintext_len, char* ciphertext, int& ciphertext_len, const DesKeySchedule& schedule) const;
+    bool Decry(const char* ciphertext, int ciphertext_len, char* plaintext, int& plaintext_len, const DesKeySchedule& schedule) const;
+
 private:
-    // 子密钥数组，存储16轮子密钥
-    unsigned int m_arrOutKey[16][2];
+    // 子密钥数组，存储16轮子密钥（供按密钥调用的接口使用）
+    DesKeySchedule m_arrOutKey;
 
     // 生成初始密钥
-    void MakeFirstKey(const char* key, int key_len);
+    static void MakeFirstKey(const char* key, int key_len, DesKeySchedule& schedule);
     
     // 生成16轮子密钥
-    void MakeKey();
+    static void MakeKey(DesKeySchedule& schedule);
     
     // 加密单个64位块
-    void EncryBlock(unsigned int& left, unsigned int& right);
+    static void EncryBlock(unsigned int& left, unsigned int& right, const DesKeySchedule& schedule);
     
     // 解密单个64位块
-    void DecryBlock(unsigned int& left, unsigned int& right);
+    static void DecryBlock(unsigned int& left, unsigned int& right, const DesKeySchedule& schedule);
     
     // DES算法的F函数
-    unsigned int F(unsigned int r, unsigned int k0, unsigned int k1);
+    static unsigned int F(unsigned int r, unsigned int k0, unsigned int k1);
 };
 
 // DES算法相关常量表
@@ -0,0 +1,244 @@
+// DES吞吐量基准测试：测量CDesOperate加解密在不同消息长度下的吞吐量（MB/s、每字节周期数），
+// 以及密钥展开与分组处理各自的单次开销。运行前先与参考输出逐字节比对，输出不一致时直接失败，
+// 防止优化后的实现悄悄改变密文。
+// 用法: ./des_bench [--json] [--quick]
+//   --json   每个结果输出一行JSON，便于记录趋势
+//   --quick  缩短每项的测量时间，只用于冒烟测试
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "des.h"
+
+#define BENCH_MIN_SECONDS 0.5         // 每项至少测量的时间
+#define BENCH_QUICK_SECONDS 0.05
+#define BENCH_MAX_SIZE (16 * 1024 * 1024)
+
+// 参考实现的输出（不是标准DES，以本仓库当前实现为准）
+static const char GOLDEN_KEY[8] = {0x13, 0x34, 0x57, 0x79, (char)0x9B, (char)0xBC, (char)0xDF, (char)0xF1};
+
+struct GoldenVector {
+    const char* plaintext;
+    int length;
+    const char* ciphertext_hex;
+};
+
+static const GoldenVector GOLDEN_VECTORS[] = {
+    {"\x01\x23\x45\x67\x89\xab\xcd\xef", 8, "34fd7cbf59ad59c6"},
+    {"hello, chatroom", 15, "5c669692b22bd993099ffaaf07f13054"},
+    {"The quick brown fox jumps over the lazy dog. 0123456789!", 56,
+     "fa22df0be3828318b49d2b74921dd6281ea7a5e01c45a030093a42a6fc1cafebf2e0bb48a22400677fc52c50e926848ba1577fe37df7f4a7"},
+};
+
+// 1MB规律明文（第i字节为i*31+7）加密后的FNV-1a摘要
+#define GOLDEN_BULK_SIZE (1024 * 1024)
+#define GOLDEN_BULK_DIGEST 0x9424c3c19abc6383ULL
+
+static uint64_t Fnv1a(const char* data, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string ToHex(const char* data, int len) {
+    std::string out;
+    char hex[3];
+    for (int i = 0; i < len; i++) {
+        snprintf(hex, sizeof(hex), "%02x", (unsigned char)data[i]);
+        out += hex;
+    }
+    return out;
+}
+
+static uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 时间戳计数器读数；非x86平台返回0，此时不输出每字节周期数
+static uint64_t ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 与参考输出比对：固定向量、1MB摘要、两种接口的一致性以及解密还原
+static bool VerifyReference() {
+    CDesOperate des;
+    DesKeySchedule schedule;
+    CDesOperate::ExpandKey(GOLDEN_KEY, 8, schedule);
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(GOLDEN_VECTORS) / sizeof(GOLDEN_VECTORS[0]); i++) {
+        const GoldenVector& vector = GOLDEN_VECTORS[i];
+        char cipher[128], by_key[128], plain[128];
+        int cipher_len = sizeof(cipher), by_key_len = sizeof(by_key), plain_len = sizeof(plain);
+        des.Encry(vector.plaintext, vector.length, cipher, cipher_len, schedule);
+        des.Encry(vector.plaintext, vector.length, by_key, by_key_len, GOLDEN_KEY, 8);
+        des.Decry(cipher, cipher_len, plain, plain_len, schedule);
+
+        std::string hex = ToHex(cipher, cipher_len);
+        if (hex != vector.ciphertext_hex) {
+            fprintf(stderr, "参考向量%zu不一致:\n  期望 %s\n  实际 %s\n", i, vector.ciphertext_hex, hex.c_str());
+            ok = false;
+        }
+        if (by_key_len != cipher_len || memcmp(by_key, cipher, cipher_len) != 0) {
+            fprintf(stderr, "参考向量%zu: 按密钥加密与按密钥编排加密的结果不同\n", i);
+            ok = false;
+        }
+        if (memcmp(plain, vector.plaintext, vector.length) != 0) {
+            fprintf(stderr, "参考向量%zu: 解密未能还原明文\n", i);
+            ok = false;
+        }
+    }
+
+    std::vector<char> bulk(GOLDEN_BULK_SIZE), cipher(GOLDEN_BULK_SIZE), plain(GOLDEN_BULK_SIZE);
+    for (size_t i = 0; i < bulk.size(); i++) {
+        bulk[i] = (char)(i * 31 + 7);
+    }
+    int cipher_len = cipher.size(), plain_len = plain.size();
+    des.Encry(bulk.data(), bulk.size(), cipher.data(), cipher_len, schedule);
+    uint64_t digest = Fnv1a(cipher.data(), cipher_len);
+    if (digest != GOLDEN_BULK_DIGEST) {
+        fprintf(stderr, "1MB密文摘要不一致: 期望 %016llx，实际 %016llx\n",
+                (unsigned long long)GOLDEN_BULK_DIGEST, (unsigned long long)digest);
+        ok = false;
+    }
+    des.Decry(cipher.data(), cipher_len, plain.data(), plain_len, schedule);
+    if (plain != bulk) {
+        fprintf(stderr, "1MB数据解密未能还原明文\n");
+        ok = false;
+    }
+    return ok;
+}
+
+// 一项测量结果
+struct BenchResult {
+    std::string name;
+    size_t bytes;            // 每次调用处理的字节数，0表示不按字节计
+    uint64_t calls;
+    uint64_t elapsed_ns;
+    uint64_t cycles;
+};
+
+// 反复调用run直到累计时间达到min_seconds；每轮调用次数翻倍，计时开销可以忽略。
+// 第一次调用用于预热（缓存、分支预测与页表），单次就超过min_seconds的大消息直接以它为结果
+template <typename F>
+static BenchResult Measure(const std::string& name, size_t bytes, double min_seconds, F run) {
+    BenchResult result = {name, bytes, 0, 0, 0};
+    uint64_t start = NowNs();
+    uint64_t start_cycles = ReadCycles();
+    run();
+    uint64_t warmup_ns = NowNs() - start;
+    if (warmup_ns >= min_seconds * 1e9) {
+        result.cycles = ReadCycles() - start_cycles;
+        result.elapsed_ns = warmup_ns;
+        result.calls = 1;
+        return result;
+    }
+
+    uint64_t batch = 1;
+    while (result.elapsed_ns < min_seconds * 1e9) {
+        start = NowNs();
+        start_cycles = ReadCycles();
+        for (uint64_t i = 0; i < batch; i++) {
+            run();
+        }
+        result.cycles += ReadCycles() - start_cycles;
+        result.elapsed_ns += NowNs() - start;
+        result.calls += batch;
+        batch *= 2;
+    }
+    return result;
+}
+
+static void Report(const BenchResult& result, bool json) {
+    double ns_per_call = (double)result.elapsed_ns / result.calls;
+    double total_bytes = (double)result.bytes * result.calls;
+    double mb_per_s = result.bytes ? total_bytes / (result.elapsed_ns / 1e9) / (1024 * 1024) : 0;
+    double cycles_per_byte = result.bytes && result.cycles ? result.cycles / total_bytes : 0;
+    double cycles_per_call = result.cycles ? (double)result.cycles / result.calls : 0;
+
+    if (json) {
+        printf("{\"name\":\"%s\",\"bytes\":%zu,\"calls\":%llu,\"ns_per_call\":%.1f,"
+               "\"mb_per_s\":%.2f,\"cycles_per_byte\":%.2f,\"cycles_per_call\":%.1f}\n",
+               result.name.c_str(), result.bytes, (unsigned long long)result.calls, ns_per_call,
+               mb_per_s, cycles_per_byte, cycles_per_call);
+    } else if (result.bytes) {
+        printf("%-18s %10zu %14.1f %10.2f %12.2f\n", result.name.c_str(), result.bytes, ns_per_call,
+               mb_per_s, cycles_per_byte);
+    } else {
+        printf("%-18s %10s %14.1f %10s %12s\n", result.name.c_str(), "-", ns_per_call, "-", "-");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    double min_seconds = BENCH_MIN_SECONDS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            min_seconds = BENCH_QUICK_SECONDS;
+        } else {
+            fprintf(stderr, "用法: %s [--json] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!VerifyReference()) {
+        fprintf(stderr, "输出与参考实现不一致，放弃测量\n");
+        return 1;
+    }
+    if (!json) {
+        printf("参考输出校验通过\n");
+        printf("%-18s %10s %14s %10s %12s\n", "项目", "字节", "ns/次", "MB/s", "周期/字节");
+    }
+
+    CDesOperate des;
+    DesKeySchedule schedule;
+    CDesOperate::ExpandKey(GOLDEN_KEY, 8, schedule);
+
+    // 密钥展开与单个分组的开销：按密钥调用的接口每次都要重新展开
+    char block_in[8] = {0}, block_out[8];
+    Report(Measure("key_expand", 0, min_seconds, [&]() {
+        CDesOperate::ExpandKey(GOLDEN_KEY, 8, schedule);
+    }), json);
+    Report(Measure("block_schedule", 8, min_seconds, [&]() {
+        int len = sizeof(block_out);
+        des.Encry(block_in, 8, block_out, len, schedule);
+    }), json);
+    Report(Measure("block_with_key", 8, min_seconds, [&]() {
+        int len = sizeof(block_out);
+        des.Encry(block_in, 8, block_out, len, GOLDEN_KEY, 8);
+    }), json);
+
+    // 不同消息长度的加解密吞吐量
+    std::vector<char> input(BENCH_MAX_SIZE), output(BENCH_MAX_SIZE);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (char)(i * 31 + 7);
+    }
+    for (size_t size = 8; size <= BENCH_MAX_SIZE; size *= 8) {
+        Report(Measure("encrypt", size, min_seconds, [&]() {
+            int len = output.size();
+            des.Encry(input.data(), size, output.data(), len, schedule);
+        }), json);
+        Report(Measure("decrypt", size, min_seconds, [&]() {
+            int len = output.size();
+            des.Decry(input.data(), size, output.data(), len, schedule);
+        }), json);
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "protocol.h"
+
+#define FILE_RECV_DIR "received"               // 默认的接收目录
+#define FILE_ACK_BYTES (1024 * 1024)           // 接收方每写入这么多字节确认一次
+#define FILE_REPLY_TIMEOUT_MS 10000            // 发送方等待对端接受或完成通知的时间
+#define FILE_PART_SUFFIX ".part"               // 接收中的文件
+#define FILE_STATE_SUFFIX ".part.state"        // 接收进度，续传时读取
+
+// 从offset起读满len字节，失败或遇到文件结尾返回false
+inline bool PreadFull(int fd, char* buffer, int len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buffer, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buffer += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+inline bool PwriteFull(int fd, const char* data, int len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// 发送方一次文件传输的状态：传输线程等待，接收线程收到对端的控制帧后更新并唤醒
+struct FileSendState {
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t stream_id;        // 正在发送的流编号，0表示没有
+    int reply;                 // 对端最近的FILE_ACCEPT/FILE_DONE/FILE_ABORT，0表示尚未回复
+    uint64_t resume_offset;    // 对端接受时给出的起始偏移
+    uint64_t acked;            // 对端确认已写入的字节数
+    bool closed;               // 连接已关闭
+    bool busy;                 // /send命令的传输线程正在运行
+
+    FileSendState() : stream_id(0), reply(0), resume_offset(0), acked(0), closed(false), busy(false) {}
+};
+
+// 接收方的一个文件
+// 数据按偏移写入"<名称>.part"，已确认的偏移记录在"<名称>.part.state"中；连接中断后两个文件保留，
+// 对端再次发送同名、同大小、同修改时间的文件时从已确认的偏移继续，完成后改名为最终文件名。
+// 只由接收线程访问，不加锁。
+class FileReceiver {
+public:
+    FileReceiver() : m_fd(-1), m_state_fd(-1), m_stream_id(0), m_size(0), m_mtime(0), m_received(0), m_acked(0) {}
+    ~FileReceiver() { Close(); }
+
+    // 文件名不能含目录
+    static bool ValidName(const char* name) {
+        return name[0] != '\0' && strchr(name, '/') == NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+    }
+
+    // 准备在dir中接收文件，resume返回起始偏移
+    bool Open(const std::string& dir, uint32_t stream_id, const char* name, uint64_t size, int64_t mtime,
+              uint64_t& resume) {
+        Close();
+        if (!ValidName(name) || (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)) {
+            return false;
+        }
+        m_path = dir + "/" + name;
+        m_state_fd = open((m_path + FILE_STATE_SUFFIX).c_str(), O_RDWR | O_CREAT, 0600);
+        if (m_state_fd < 0) {
+            return false;
+        }
+
+        // 上次未完成的同一文件：已确认的部分必须仍在.part文件中
+        ResumeState state;
+        struct stat part;
+        bool same = pread(m_state_fd, &state, sizeof(state), 0) == (ssize_t)sizeof(state) &&
+                    state.size == size && state.mtime == mtime && state.offset <= size &&
+                    stat((m_path + FILE_PART_SUFFIX).c_str(), &part) == 0 && (uint64_t)part.st_size >= state.offset;
+        m_fd = open((m_path + FILE_PART_SUFFIX).c_str(), O_WRONLY | O_CREAT | (same ? 0 : O_TRUNC), 0600);
+        if (m_fd < 0) {
+            Close();
+            return false;
+        }
+        m_stream_id = stream_id;
+        m_size = size;
+        m_mtime = mtime;
+        m_received = same ? state.offset : 0;
+        m_acked = m_received;
+        resume = m_received;
+        return same || Checkpoint();
+    }
+
+    // 写入一块，数据必须紧接在已写入的部分之后
+    bool Write(uint64_t offset, const char* data, int len) {
+        if (m_fd < 0 || offset != m_received || len > (int64_t)(m_size - offset) ||
+            !PwriteFull(m_fd, data, len, offset)) {
+            return false;
+        }
+        m_received += len;
+        return true;
+    }
+
+    // 把已写入的偏移记为已确认
+    bool Checkpoint() {
+        ResumeState state;
+        state.size = m_size;
+        state.mtime = m_mtime;
+        state.offset = m_received;
+        if (pwrite(m_state_fd, &state, sizeof(state), 0) != (ssize_t)sizeof(state)) {
+            return false;
+        }
+        m_acked = m_received;
+        return true;
+    }
+
+    // 全部收到：改为最终文件名并删除进度文件
+    bool Finish() {
+        if (m_received != m_size) {
+            return false;
+        }
+        close(m_fd);
+        m_fd = -1;
+        bool ok = rename((m_path + FILE_PART_SUFFIX).c_str(), m_path.c_str()) == 0;
+        if (ok) {
+            unlink((m_path + FILE_STATE_SUFFIX).c_str());
+        }
+        Close();
+        return ok;
+    }
+
+    // 停止接收，未完成的文件与进度保留以便续传
+    void Close() {
+        if (m_fd >= 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+        if (m_state_fd >= 0) {
+            close(m_state_fd);
+            m_state_fd = -1;
+        }
+        m_stream_id = 0;
+    }
+
+    bool Active() const { return m_fd >= 0; }
+    uint32_t StreamId() const { return m_stream_id; }
+    const std::string& Path() const { return m_path; }
+    uint64_t Size() const { return m_size; }
+    uint64_t Received() const { return m_received; }
+    uint64_t Acked() const { return m_acked; }
+
+private:
+    FileReceiver(const FileReceiver&) = delete;
+    FileReceiver& operator=(const FileReceiver&) = delete;
+
+    struct ResumeState {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t offset;       // 已确认写入的字节数
+    };
+
+    int m_fd;                  // .part文件
+    int m_state_fd;            // .part.state文件
+    uint32_t m_stream_id;
+    std::string m_path;        // 最终文件名
+    uint64_t m_size;
+    int64_t m_mtime;
+    uint64_t m_received;       // 已写入的字节数
+    uint64_t m_acked;          // 已确认的字节数
+};
+
+#endif // FILE_TRANSFER_H
@@ -0,0 +1,263 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <type_traits>
+
+// 二进制日志的记录格式表：X(格式编号, 格式串)
+// 整数参数对应%d/%u/%x等转换，字符串与字节参数对应%s（字节参数以十六进制预览显示）。
+// 编号即写入文件的格式ID，只能在表末尾追加，不能修改或删除已有条目，否则旧日志无法解码。
+#define LOG_FORMAT_TABLE(X) \
+    X(LOGF_TEXT,         "%s") \
+    X(LOGF_SEND_DONE,    "发送数据完成: 总计 %d 字节") \
+    X(LOGF_RECV_CHUNK,   "接收数据块: %d 字节，累计: %d/%d") \
+    X(LOGF_RECV_DONE,    "已完整接收所需数据: %d 字节") \
+    X(LOGF_FRAME_SENT,   "发送加密数据 (HEX): CRC=%x | %s (%d字节, 序号%u)") \
+    X(LOGF_FRAME_RECV,   "接收加密数据 (HEX): CRC=%x | %s (%d字节, 序号%u)") \
+    X(LOGF_MESSAGE_RECV, "从 %s 接收到解密消息: %s")
+
+enum LogFormatId {
+#define LOG_FORMAT_ENUM(id, format) id,
+    LOG_FORMAT_TABLE(LOG_FORMAT_ENUM)
+#undef LOG_FORMAT_ENUM
+    LOGF_COUNT
+};
+
+#define LOGF_SESSION 0xFFFF        // 会话开始记录，参数为打开日志时的实时时钟与单调时钟（纳秒）
+#define LOG_BYTES_PREVIEW 32       // 字节参数最多保存的字节数
+
+// 取得格式编号对应的格式串，未知编号返回NULL
+inline const char* LogFormatString(unsigned id) {
+    static const char* const formats[] = {
+#define LOG_FORMAT_STRING(id, format) format,
+        LOG_FORMAT_TABLE(LOG_FORMAT_STRING)
+#undef LOG_FORMAT_STRING
+    };
+    return id < LOGF_COUNT ? formats[id] : NULL;
+}
+
+// 参数类型
+enum LogArgType {
+    LOG_ARG_INT = 1,      // 8字节整数
+    LOG_ARG_STR = 2,      // 4字节长度 + 字符串
+    LOG_ARG_BYTES = 3     // 4字节原始长度 + 4字节保存长度 + 字节
+};
+
+// 二进制日志记录头，其后紧跟length字节的参数区
+// 字段按本机字节序写入，日志须在同类机器上解码
+struct LogRecordHeader {
+    uint16_t format_id;       // LogFormatId或LOGF_SESSION
+    uint8_t level;            // LogLevel
+    uint8_t argc;             // 参数个数
+    uint32_t length;          // 参数区字节数
+    uint64_t timestamp_ns;    // 单调时钟时间戳（纳秒）
+};
+
+// 字节参数：记录时只保存前LOG_BYTES_PREVIEW个字节
+struct LogBytes {
+    const void* data;
+    int len;
+    LogBytes(const void* d, int l) : data(d), len(l) {}
+};
+
+// 将数据的前limit个字节格式化为十六进制，超出部分以"..."表示
+inline std::string LogHexDump(const void* data, int len, int limit = LOG_BYTES_PREVIEW) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    int shown = len > limit ? limit : len;
+    std::string out;
+    out.reserve(shown * 3 + 3);
+    char hex[4];
+    for (int i = 0; i < shown; i++) {
+        snprintf(hex, sizeof(hex), "%02x ", bytes[i]);
+        out += hex;
+    }
+    if (len > limit) {
+        out += "...";
+    }
+    return out;
+}
+
+// 写入十进制数字，width大于0时左侧补零到该宽度，返回写入后的位置
+inline char* LogAppendDigits(char* p, uint64_t value, int width) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (n < width) {
+        digits[n++] = '0';
+    }
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+// 日志时间戳格式化缓存
+// 格式为"YYYY-MM-DD HH:MM:SS.uuuuuu @秒.微秒"，@之后为单调时钟，用于计算同一台机器上的时间间隔。
+// 日期时间部分只在秒数变化时重新调用localtime_r/strftime，微秒与单调时钟部分直接写入数字。
+class LogTimestampCache {
+public:
+    LogTimestampCache() : m_second(-1), m_prefix_len(0) {}
+
+    // 格式化时间戳到out（至少LOG_TIMESTAMP_SIZE字节），返回长度
+    int Format(uint64_t real_ns, uint64_t mono_ns, char* out) {
+        time_t second = real_ns / 1000000000ULL;
+        if (second != m_second) {
+            struct tm timeInfo;
+            localtime_r(&second, &timeInfo);
+            m_prefix_len = strftime(m_prefix, sizeof(m_prefix), "%Y-%m-%d %H:%M:%S", &timeInfo);
+            m_second = second;
+        }
+
+        char* p = out;
+        memcpy(p, m_prefix, m_prefix_len);
+        p += m_prefix_len;
+        *p++ = '.';
+        p = LogAppendDigits(p, real_ns / 1000 % 1000000, 6);
+        *p++ = ' ';
+        *p++ = '@';
+        p = LogAppendDigits(p, mono_ns / 1000000000ULL, 0);
+        *p++ = '.';
+        p = LogAppendDigits(p, mono_ns / 1000 % 1000000, 6);
+        return p - out;
+    }
+
+private:
+    time_t m_second;        // 缓存对应的秒数
+    char m_prefix[32];      // 已格式化的日期时间
+    int m_prefix_len;
+};
+
+#define LOG_TIMESTAMP_SIZE 64
+
+// 参数编码
+inline void LogEncodeRaw(std::string& out, const void* data, size_t len) {
+    out.append((const char*)data, len);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type LogEncodeArg(std::string& out, T value) {
+    uint64_t raw = (uint64_t)value;
+    out += (char)LOG_ARG_INT;
+    LogEncodeRaw(out, &raw, sizeof(raw));
+}
+
+inline void LogEncodeArg(std::string& out, const char* value) {
+    uint32_t len = value ? strlen(value) : 0;
+    out += (char)LOG_ARG_STR;
+    LogEncodeRaw(out, &len, sizeof(len));
+    LogEncodeRaw(out, value, len);
+}
+
+inline void LogEncodeArg(std::string& out, const std::string& value) {
+    uint32_t len = value.size();
+    out += (char)LOG_ARG_STR;
+    LogEncodeRaw(out, &len, sizeof(len));
+    LogEncodeRaw(out, value.data(), len);
+}
+
+inline void LogEncodeArg(std::string& out, const LogBytes& value) {
+    uint32_t total = value.len > 0 ? value.len : 0;
+    uint32_t kept = total > LOG_BYTES_PREVIEW ? LOG_BYTES_PREVIEW : total;
+    out += (char)LOG_ARG_BYTES;
+    LogEncodeRaw(out, &total, sizeof(total));
+    LogEncodeRaw(out, &kept, sizeof(kept));
+    LogEncodeRaw(out, value.data, kept);
+}
+
+inline void LogEncodeArgs(std::string&) {}
+
+template <typename T, typename... Rest>
+void LogEncodeArgs(std::string& out, const T& first, const Rest&... rest) {
+    LogEncodeArg(out, first);
+    LogEncodeArgs(out, rest...);
+}
+
+// 按格式串渲染已编码的参数区，追加到out；参数区损坏时返回false
+inline bool LogRenderRecord(const char* format, const char* args, size_t len, std::string& out) {
+    size_t pos = 0;
+    bool ok = true;
+    for (const char* p = format; *p; p++) {
+        if (*p != '%') {
+            out += *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out += '%';
+            p++;
+            continue;
+        }
+
+        // 解析转换说明：标志、宽度、精度保留，长度修饰统一替换为ll
+        std::string spec = "%";
+        p++;
+        while (*p && strchr("-+ #0123456789.", *p)) {
+            spec += *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        char conv = *p;
+
+        if (pos >= len) {
+            out += "<?>";
+            ok = false;
+            continue;
+        }
+        uint8_t type = (uint8_t)args[pos++];
+        if (type == LOG_ARG_INT && pos + 8 <= len) {
+            uint64_t raw;
+            memcpy(&raw, args + pos, 8);
+            pos += 8;
+            char buffer[64];
+            if (strchr("diuxXo", conv)) {
+                spec += "ll";
+                spec += conv;
+                snprintf(buffer, sizeof(buffer), spec.c_str(), (long long)raw);
+            } else {
+                snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)raw);
+            }
+            out += buffer;
+        } else if (type == LOG_ARG_STR && pos + 4 <= len) {
+            uint32_t n;
+            memcpy(&n, args + pos, 4);
+            pos += 4;
+            if (pos + n > len) {
+                ok = false;
+                break;
+            }
+            out.append(args + pos, n);
+            pos += n;
+        } else if (type == LOG_ARG_BYTES && pos + 8 <= len) {
+            uint32_t total, kept;
+            memcpy(&total, args + pos, 4);
+            memcpy(&kept, args + pos + 4, 4);
+            pos += 8;
+            if (pos + kept > len) {
+                ok = false;
+                break;
+            }
+            out += LogHexDump(args + pos, kept);
+            if (total > kept) {
+                out += "...";
+            }
+            pos += kept;
+        } else {
+            out += "<?>";
+            ok = false;
+            break;
+        }
+    }
+    return ok;
+}
+
+#endif // LOG_FORMAT_H
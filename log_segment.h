@@ -0,0 +1,224 @@
+#ifndef LOG_SEGMENT_H
+#define LOG_SEGMENT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <functional>
+#include <string>
+
+#define LOG_SEGMENT_BYTES (16 * 1024 * 1024)   // 默认单个日志分段16MB
+#define LOG_SEGMENT_RETENTION 5                  // 默认保留5个历史分段
+
+// 日志轮转策略
+struct LogRotationPolicy {
+    uint64_t max_bytes;     // 分段大小上限，0表示不按大小轮转（也不预分配）
+    int max_seconds;        // 分段时长上限，0表示不按时间轮转
+    int retention;          // 保留的历史分段数（name.1 ... name.N）
+    bool use_mmap;          // 是否以内存映射方式写当前分段（需要max_bytes > 0）
+
+    LogRotationPolicy()
+        : max_bytes(LOG_SEGMENT_BYTES), max_seconds(0), retention(LOG_SEGMENT_RETENTION), use_mmap(false) {}
+};
+
+// 分段日志文件
+// 当前分段始终为name，轮转时依次改名为name.1、name.2……，超出保留数的最旧分段被删除。
+// 新分段按max_bytes预分配磁盘空间，写入时不会因为扩展文件而产生额外的元数据开销；
+// 内存映射模式下写入只是一次memcpy，关闭或轮转时再把文件截断到实际长度。
+// 本类不加锁，由调用方保证同一时间只有一个线程写入。
+class LogSegmentFile {
+public:
+    LogSegmentFile() : m_fd(-1), m_map(NULL), m_map_size(0), m_offset(0), m_opened_at(0), m_rotations(0) {}
+    ~LogSegmentFile() { Close(); }
+
+    // 设置分段开头内容的生成函数（如二进制日志的会话记录），每个新分段打开时写入一次
+    void SetSegmentHeader(std::function<std::string()> header) { m_header = header; }
+
+    bool Open(const std::string& path, const LogRotationPolicy& policy) {
+        Close();
+        m_path = path;
+        m_policy = policy;
+        if (m_policy.max_bytes == 0) {
+            m_policy.use_mmap = false;
+        }
+        
+        // 内存映射模式不续写已有文件：上次异常退出时其尾部可能留有预分配的空白
+        struct stat st;
+        if (m_policy.use_mmap && stat(path.c_str(), &st) == 0 && st.st_size > 0) {
+            ShiftSegments();
+        }
+        return OpenSegment();
+    }
+
+    bool IsOpen() const { return m_fd >= 0; }
+
+    // 写入数据，需要时先轮转到新分段
+    bool Write(const char* data, size_t len) {
+        if (m_fd < 0) {
+            return false;
+        }
+        if (RotationDue(len) && !Rotate()) {
+            return false;
+        }
+
+        if (m_map != NULL && m_offset + len <= m_map_size) {
+            memcpy(m_map + m_offset, data, len);
+            m_offset += len;
+            return true;
+        }
+
+        // 单条数据超过映射区域时退回普通写入
+        if (m_map != NULL) {
+            Unmap();
+        }
+        while (len > 0) {
+            ssize_t n = pwrite(m_fd, data, len, m_offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            len -= n;
+            m_offset += n;
+        }
+        return true;
+    }
+
+    // 内存映射模式下异步回写脏页；普通写入已直接交给内核，无需额外操作
+    void Flush() {
+        if (m_map != NULL) {
+            msync(m_map, m_map_size, MS_ASYNC);
+        }
+    }
+
+    // 关闭当前分段，并释放预分配但未使用的空间
+    void Close() {
+        if (m_fd < 0) {
+            return;
+        }
+        if (m_map != NULL) {
+            Unmap();
+        } else if (m_policy.max_bytes > 0 && ftruncate(m_fd, m_offset) != 0) {
+            perror("ftruncate");
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    uint64_t Rotations() const { return m_rotations; }
+
+private:
+    // 文件的创建时间：文件系统支持时取出生时间，否则取状态改变时间（不早于创建时间，分段只会晚于上限轮转）
+    static time_t CreatedAt(int fd, const struct stat& st) {
+#ifdef STATX_BTIME
+        struct statx stx;
+        if (statx(fd, "", AT_EMPTY_PATH, STATX_BTIME, &stx) == 0 && (stx.stx_mask & STATX_BTIME)) {
+            return stx.stx_btime.tv_sec;
+        }
+#endif
+        return st.st_ctime;
+    }
+
+    bool OpenSegment() {
+        m_fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            return false;
+        }
+        struct stat st;
+        fstat(m_fd, &st);
+        m_offset = st.st_size;
+        // 追加到已有分段时沿用它的创建时间，否则频繁重启的服务每次都会重新计算分段时长，永远不按时间轮转
+        m_opened_at = st.st_size > 0 ? CreatedAt(m_fd, st) : time(nullptr);
+
+        // 预分配整个分段（不改变文件长度），失败时（如文件系统不支持）照常写入
+        if (m_policy.max_bytes > m_offset) {
+            fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_offset, m_policy.max_bytes - m_offset);
+        }
+
+        if (m_policy.use_mmap && m_offset < m_policy.max_bytes) {
+            if (ftruncate(m_fd, m_policy.max_bytes) == 0) {
+                void* map = mmap(NULL, m_policy.max_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+                if (map != MAP_FAILED) {
+                    m_map = (char*)map;
+                    m_map_size = m_policy.max_bytes;
+                } else if (ftruncate(m_fd, m_offset) != 0) {
+                    perror("ftruncate");
+                }
+            }
+        }
+
+        if (m_header) {
+            std::string header = m_header();
+            Write(header.data(), header.size());
+        }
+        return true;
+    }
+
+    // 解除映射并把文件截断到实际写入的长度，去掉预留的空白
+    void Unmap() {
+        if (m_map == NULL) {
+            return;
+        }
+        munmap(m_map, m_map_size);
+        m_map = NULL;
+        m_map_size = 0;
+        if (ftruncate(m_fd, m_offset) != 0) {
+            perror("ftruncate");
+        }
+    }
+
+    bool RotationDue(size_t incoming) const {
+        if (m_offset == 0) {
+            return false;
+        }
+        if (m_policy.max_bytes > 0 && m_offset + incoming > m_policy.max_bytes) {
+            return true;
+        }
+        return m_policy.max_seconds > 0 && time(nullptr) - m_opened_at >= m_policy.max_seconds;
+    }
+
+    // 关闭当前分段，历史分段编号依次后移，再打开新的当前分段
+    bool Rotate() {
+        Close();
+        ShiftSegments();
+        m_rotations++;
+        return OpenSegment();
+    }
+
+    // 当前分段改名为name.1，其余历史分段编号加一，删除超出保留数的分段
+    void ShiftSegments() {
+        if (m_policy.retention > 0) {
+            unlink(SegmentName(m_policy.retention).c_str());
+            for (int i = m_policy.retention - 1; i >= 1; i--) {
+                rename(SegmentName(i).c_str(), SegmentName(i + 1).c_str());
+            }
+            rename(m_path.c_str(), SegmentName(1).c_str());
+        } else {
+            unlink(m_path.c_str());
+        }
+    }
+
+    std::string SegmentName(int index) const {
+        return m_path + "." + std::to_string(index);
+    }
+
+    std::string m_path;                       // 当前分段路径
+    LogRotationPolicy m_policy;
+    int m_fd;
+    char* m_map;                              // 内存映射区域（仅mmap模式）
+    size_t m_map_size;
+    uint64_t m_offset;                        // 当前分段已写入的长度
+    time_t m_opened_at;                       // 当前分段的创建时间
+    uint64_t m_rotations;                     // 已轮转次数
+    std::function<std::string()> m_header;    // 分段开头内容
+};
+
+#endif // LOG_SEGMENT_H
@@ -0,0 +1,91 @@
+// 二进制日志解码工具：把Logger二进制模式写出的记录渲染为与文本日志相同格式的文本
+// 用法: ./logdecode chatroom_server.log.bin [更多文件...]
+#include <stdio.h>
+#include <time.h>
+#include <fstream>
+#include <iostream>
+
+#include "logger.h"
+
+// 读取参数区中第index个整数参数
+static bool ReadIntArg(const std::string& args, int index, uint64_t& value) {
+    size_t pos = index * 9;
+    if (pos + 9 > args.size() || (uint8_t)args[pos] != LOG_ARG_INT) {
+        return false;
+    }
+    memcpy(&value, args.data() + pos + 1, 8);
+    return true;
+}
+
+// 把记录的单调时钟时间戳换算为与文本日志相同的时间格式
+static std::string FormatTimestamp(LogTimestampCache& cache, uint64_t timestamp_ns,
+                                   bool have_base, uint64_t base_real, uint64_t base_mono) {
+    char buffer[LOG_TIMESTAMP_SIZE];
+    if (!have_base) {
+        snprintf(buffer, sizeof(buffer), "@%llu ns", (unsigned long long)timestamp_ns);
+        return buffer;
+    }
+    int len = cache.Format(base_real + (timestamp_ns - base_mono), timestamp_ns, buffer);
+    return std::string(buffer, len);
+}
+
+static bool DecodeFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "无法打开文件: %s\n", path);
+        return false;
+    }
+
+    bool have_base = false;
+    uint64_t base_real = 0, base_mono = 0;
+    LogTimestampCache cache;
+    LogRecordHeader header;
+    std::string args;
+    std::string line;
+    while (in.read((char*)&header, sizeof(header))) {
+        // 内存映射写入的分段在进程异常退出时会留下预分配的全零尾部
+        if (header.timestamp_ns == 0 && header.length == 0) {
+            break;
+        }
+        args.resize(header.length);
+        if (header.length > 0 && !in.read(&args[0], header.length)) {
+            fprintf(stderr, "%s: 最后一条记录不完整\n", path);
+            return false;
+        }
+
+        // 会话开始记录：之后的时间戳以它为基准换算
+        if (header.format_id == LOGF_SESSION) {
+            have_base = ReadIntArg(args, 0, base_real) && ReadIntArg(args, 1, base_mono);
+            continue;
+        }
+
+        const char* format = LogFormatString(header.format_id);
+        if (format == NULL) {
+            fprintf(stderr, "%s: 未知格式编号 %u，跳过\n", path, (unsigned)header.format_id);
+            continue;
+        }
+
+        line = FormatTimestamp(cache, header.timestamp_ns, have_base, base_real, base_mono);
+        line += " [";
+        line += LogLevelName(header.level);
+        line += "] ";
+        if (!LogRenderRecord(format, args.data(), args.size(), line)) {
+            line += " <参数损坏>";
+        }
+        std::cout << line << '\n';
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "用法: %s <二进制日志文件>...\n", argv[0]);
+        return 1;
+    }
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok = DecodeFile(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -2,10 +2,21 @@
 #define LOGGER_H
 
 #include <string>
-#include <fstream>
 #include <iostream>
 #include <ctime>
+#include <cstdarg>
+#include <cstdio>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <vector>
+
+#include "log_format.h"
+#include "log_segment.h"
 
 // 日志级别枚举
 enum LogLevel {
@@ -16,6 +27,62 @@ enum LogLevel {
     NONE // 不记录日志
 };
 
+// 日志级别名称
+inline const char* LogLevelName(int level) {
+    switch (level) {
+        case DEBUG:   return "调试";
+        case INFO:    return "信息";
+        case WARNING: return "警告";
+        case ERROR:   return "错误";
+        default:      return "未知";
+    }
+}
+
+// 编译期最低日志级别：低于该级别的日志调用在编译时即被移除
+// 发布构建可使用 -DLOG_MIN_LEVEL=INFO 去掉全部调试日志
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
+// 异步模式下队列已满时的处理策略
+enum LogOverflowPolicy {
+    LOG_OVERFLOW_BLOCK,   // 等待后台线程腾出空间，不丢日志
+    LOG_OVERFLOW_DROP,    // 直接丢弃新日志
+    LOG_OVERFLOW_COUNT    // 丢弃新日志，并由后台线程在日志中记录丢弃条数
+};
+
+#define LOG_ASYNC_CAPACITY 8192      // 异步模式下每个线程暂存缓冲区的默认容量（条）
+#define LOG_THREAD_FLUSH_ENTRIES 64  // 线程缓冲区积累到该条数时唤醒后台线程
+#define LOG_FLUSH_INTERVAL_MS 20     // 后台线程收集各线程缓冲区的最长间隔
+#define LOG_MERGE_WINDOW_NS 1000000  // 合并排序时暂缓写入最近1ms内的记录
+
+// 日志统计信息
+struct LoggerStats {
+    uint64_t written;       // 已写入文件的记录数
+    uint64_t dropped;       // 因队列已满被丢弃的记录数
+    uint64_t batches;       // 后台线程写入批次数
+    size_t queue_depth;     // 各线程缓冲区中尚未写入的记录数
+    size_t capacity;        // 每个线程缓冲区的容量，同步模式为0
+    size_t threads;         // 已登记暂存缓冲区的线程数
+};
+
+// 异步模式下暂存在线程缓冲区中的一条记录
+struct LogEntry {
+    uint64_t timestamp_ns;  // 单调时钟时间戳，合并多个线程的记录时按它排序
+    std::string data;       // 文本行（不含换行符）或二进制记录
+};
+
+// 每个线程独占的日志暂存缓冲区
+// 记录日志的线程只向自己的缓冲区追加，锁只会与后台线程收集时竞争，线程之间互不阻塞。
+struct ThreadLogBuffer {
+    std::mutex mutex;
+    std::vector<LogEntry> entries;
+    std::condition_variable drained;  // 后台线程取走记录后通知，LOG_OVERFLOW_BLOCK时缓冲区已满的线程在此等待
+    std::atomic<bool> orphaned;     // 所属线程已退出，写完剩余记录后移除
+
+    ThreadLogBuffer() : orphaned(false) {}
+};
+
 class Logger {
 public:
     // 获取日志单例实例
@@ -25,58 +92,150 @@ public:
     }
 
     // 初始化日志系统
+    // 二进制模式下文件名追加".bin"后缀，避免与文本日志混写
     void init(const std::string& filename, LogLevel consoleLevel = INFO, LogLevel fileLevel = DEBUG) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_logFile.open(filename, std::ios::out | std::ios::app);
-        m_consoleLevel = consoleLevel;
-        m_fileLevel = fileLevel;
+        bool opened;
+        std::string path = m_binary ? filename + ".bin" : filename;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // 二进制日志的每个分段以会话记录开头：解码时据此把单调时钟换算为实际时间
+            if (m_binary) {
+                m_logFile.SetSegmentHeader([]() {
+                    return encodeRecord(LOGF_SESSION, INFO, 2, [](std::string& out) {
+                        LogEncodeArgs(out, realtimeNs(), monotonicNs());
+                    });
+                });
+            }
+            opened = m_logFile.Open(path, m_rotation);
+            m_consoleLevel = consoleLevel;
+            m_fileLevel = fileLevel;
+            m_fileOpen = opened;
+        }
         
-        if (m_logFile.is_open()) {
+        // log()自行加锁，必须在释放m_mutex之后调用
+        if (opened) {
             log(INFO, "日志系统启动");
         } else {
-            std::cerr << "无法打开日志文件: " << filename << std::endl;
+            std::cerr << "无法打开日志文件: " << path << std::endl;
         }
     }
 
-    // 关闭日志
-    void close() {
+    // 设置日志轮转策略（分段大小、时长、保留数、是否内存映射），必须在init之前调用
+    // 异步模式下轮转在后台写线程中完成，不阻塞记录日志的线程
+    void setRotation(const LogRotationPolicy& policy) { m_rotation = policy; }
+
+    // 启用二进制模式：文件中只写入格式编号与原始参数，由logdecode工具离线渲染为文本
+    // 必须在init之前调用
+    void enableBinary() { m_binary = true; }
+
+    // 启用异步模式：每个线程把记录追加到自己的暂存缓冲区，后台线程定期收集、
+    // 按时间戳合并后批量写入文件。capacity为每个线程缓冲区的容量。
+    // 可在init之前或之后调用，重复调用无效
+    void enableAsync(size_t capacity = LOG_ASYNC_CAPACITY, LogOverflowPolicy policy = LOG_OVERFLOW_BLOCK) {
         std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_logFile.is_open()) {
+        if (m_async) {
+            return;
+        }
+        m_capacity = capacity;
+        m_policy = policy;
+        m_stopWriter = false;
+        m_async = true;
+        m_writer = std::thread(&Logger::writerLoop, this);
+    }
+
+    // 关闭日志，异步模式下先写完队列中的全部记录
+    void close() {
+        if (m_fileOpen) {
             log(INFO, "日志系统关闭");
-            m_logFile.close();
         }
+        stopWriter();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fileOpen = false;
+        m_logFile.Close();
     }
 
     // 记录日志
     void log(LogLevel level, const std::string& message) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        bool toFile = level >= m_fileLevel && m_fileOpen;
+        bool toConsole = level >= m_consoleLevel;
+        if (!toFile && !toConsole) {
+            return;
+        }
         
-        std::string levelStr;
-        switch (level) {
-            case DEBUG:   levelStr = "调试"; break;
-            case INFO:    levelStr = "信息"; break;
-            case WARNING: levelStr = "警告"; break;
-            case ERROR:   levelStr = "错误"; break;
-            default:      levelStr = "未知"; break;
+        // 二进制模式下文件中只保存原始消息，不做时间格式化
+        if (m_binary && toFile) {
+            writeRecord(encodeRecord(LOGF_TEXT, level, 1, [&](std::string& out) {
+                LogEncodeArg(out, message);
+            }));
+            toFile = false;
+            if (!toConsole) {
+                return;
+            }
         }
 
-        std::string timestamp = getCurrentTimestamp();
-        std::string formattedMessage = timestamp + " [" + levelStr + "] " + message;
+        uint64_t timestamp;
+        std::string formattedMessage = formatLine(level, message, &timestamp);
+        
+        // 输出到控制台（如果级别满足要求）
+        if (toConsole) {
+            writeConsole(level, formattedMessage);
+        }
         
         // 写入文件（如果级别满足要求且文件已打开）
-        if (level >= m_fileLevel && m_logFile.is_open()) {
-            m_logFile << formattedMessage << std::endl;
-            m_logFile.flush();
+        if (toFile) {
+            writeFile(std::move(formattedMessage), timestamp);
+        }
+    }
+
+    // 记录固定格式的日志：二进制模式下只写入格式编号与原始参数，文本模式下按格式表渲染
+    template <typename... Args>
+    void logRecord(LogLevel level, LogFormatId id, const Args&... args) {
+        bool toFile = level >= m_fileLevel && m_fileOpen;
+        bool toConsole = level >= m_consoleLevel;
+        if (!toFile && !toConsole) {
+            return;
         }
         
-        // 输出到控制台（如果级别满足要求）
-        if (level >= m_consoleLevel) {
-            if (level == ERROR) {
-                std::cerr << formattedMessage << std::endl;
-            } else {
-                std::cout << formattedMessage << std::endl;
+        std::string record = encodeRecord(id, level, sizeof...(Args), [&](std::string& out) {
+            LogEncodeArgs(out, args...);
+        });
+        if (m_binary && toFile) {
+            if (toConsole) {
+                writeConsole(level, formatLine(level, renderRecord(id, record)));
             }
+            writeRecord(std::move(record));
+            return;
         }
+        log(level, renderRecord(id, record));
+    }
+
+    // printf风格记录日志，只有在级别满足要求时才由宏调用，格式化开销只在需要时产生
+    void logf(LogLevel level, const char* format, ...) __attribute__((format(printf, 3, 4))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (len < 0) {
+            return;
+        }
+        if (len < (int)sizeof(buffer)) {
+            log(level, std::string(buffer, len));
+            return;
+        }
+        
+        // 栈上缓冲区不够时按实际长度重新格式化
+        std::string message(len, '\0');
+        va_start(args, format);
+        vsnprintf(&message[0], len + 1, format, args);
+        va_end(args);
+        log(level, message);
+    }
+
+    // 该级别的日志是否会输出到控制台或文件，供宏在构造消息之前判断
+    bool isEnabled(LogLevel level) const {
+        return level >= m_consoleLevel.load(std::memory_order_relaxed) ||
+               (level >= m_fileLevel.load(std::memory_order_relaxed) && m_fileOpen.load(std::memory_order_relaxed));
     }
 
     // 辅助方法：记录不同级别的日志
@@ -91,35 +250,333 @@ public:
     // 设置文件输出级别
     void setFileLevel(LogLevel level) { m_fileLevel = level; }
 
+    // 获取统计信息
+    LoggerStats getStats() const {
+        LoggerStats stats;
+        stats.written = m_written;
+        stats.dropped = m_dropped;
+        stats.batches = m_batches;
+        stats.queue_depth = 0;
+        stats.capacity = m_async ? m_capacity : 0;
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        stats.threads = m_buffers.size();
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            std::lock_guard<std::mutex> buffer_lock(m_buffers[i]->mutex);
+            stats.queue_depth += m_buffers[i]->entries.size();
+        }
+        return stats;
+    }
+
 private:
     // 私有构造函数（单例模式）
-    Logger() : m_consoleLevel(INFO), m_fileLevel(DEBUG) {}
+    Logger() : m_consoleLevel(INFO), m_fileLevel(DEBUG), m_fileOpen(false), m_binary(false), m_async(false), m_capacity(LOG_ASYNC_CAPACITY),
+               m_policy(LOG_OVERFLOW_BLOCK), m_stopWriter(false), m_writerIdle(false),
+               m_written(0), m_dropped(0), m_batches(0) {}
+    // 析构时确保后台线程写完并退出
+    ~Logger() { close(); }
     // 禁止复制和赋值
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     
-    // 获取当前时间戳
-    std::string getCurrentTimestamp() {
-        time_t now = time(nullptr);
-        char buffer[80];
-        struct tm timeInfo;
-        localtime_r(&now, &timeInfo);
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
-        return buffer;
-    }
-
-    std::ofstream m_logFile;   // 日志文件流
-    LogLevel m_consoleLevel;   // 控制台日志级别
-    LogLevel m_fileLevel;      // 文件日志级别
-    std::mutex m_mutex;        // 互斥锁，保证线程安全
+    // 编码一条二进制记录：记录头 + encodeArgs写入的参数区
+    template <typename F>
+    static std::string encodeRecord(unsigned id, LogLevel level, int argc, F encodeArgs) {
+        std::string record(sizeof(LogRecordHeader), '\0');
+        encodeArgs(record);
+        LogRecordHeader header;
+        header.format_id = id;
+        header.level = level;
+        header.argc = argc;
+        header.length = record.size() - sizeof(LogRecordHeader);
+        header.timestamp_ns = monotonicNs();
+        memcpy(&record[0], &header, sizeof(header));
+        return record;
+    }
+
+    // 按格式表把已编码的记录渲染为文本消息
+    static std::string renderRecord(LogFormatId id, const std::string& record) {
+        std::string message;
+        LogRenderRecord(LogFormatString(id), record.data() + sizeof(LogRecordHeader),
+                        record.size() - sizeof(LogRecordHeader), message);
+        return message;
+    }
+
+    static uint64_t realtimeNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static uint64_t monotonicNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    std::string formatLine(LogLevel level, const std::string& message, uint64_t* monotonic = NULL) {
+        return getCurrentTimestamp(monotonic) + " [" + LogLevelName(level) + "] " + message;
+    }
+
+    void writeConsole(LogLevel level, const std::string& line) {
+        std::lock_guard<std::mutex> lock(m_consoleMutex);
+        if (level == ERROR) {
+            std::cerr << line << std::endl;
+        } else {
+            std::cout << line << std::endl;
+        }
+    }
+
+    // 写入一条二进制记录，时间戳取自记录头
+    void writeRecord(std::string&& record) {
+        LogRecordHeader header;
+        memcpy(&header, record.data(), sizeof(header));
+        writeFile(std::move(record), header.timestamp_ns);
+    }
+
+    // 写入一条文件记录：文本模式为一行（不含换行符），二进制模式为一条编码后的记录
+    // timestamp_ns为记录自身的单调时钟时间戳，异步模式下用于合并排序
+    void writeFile(std::string&& entry, uint64_t timestamp_ns) {
+        if (m_async) {
+            stage(std::move(entry), timestamp_ns);
+            return;
+        }
+        if (!m_binary) {
+            entry += '\n';
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_logFile.Write(entry.data(), entry.size());
+        m_logFile.Flush();
+        m_written++;
+    }
+
+    // 获取当前时间戳：实际时间（微秒精度）与单调时钟，每个线程各自缓存秒级部分
+    // monotonic不为NULL时返回所用的单调时钟读数
+    std::string getCurrentTimestamp(uint64_t* monotonic = NULL) {
+        static thread_local LogTimestampCache cache;
+        char buffer[LOG_TIMESTAMP_SIZE];
+        uint64_t mono = monotonicNs();
+        int len = cache.Format(realtimeNs(), mono, buffer);
+        if (monotonic != NULL) {
+            *monotonic = mono;
+        }
+        return std::string(buffer, len);
+    }
+
+    // 当前线程的暂存缓冲区，第一次使用时登记到后台线程的收集列表
+    ThreadLogBuffer& localBuffer() {
+        struct Holder {
+            std::shared_ptr<ThreadLogBuffer> buffer;
+            ~Holder() {
+                if (buffer) {
+                    buffer->orphaned = true;
+                }
+            }
+        };
+        static thread_local Holder holder;
+        if (!holder.buffer) {
+            holder.buffer = std::make_shared<ThreadLogBuffer>();
+            holder.buffer->entries.reserve(LOG_THREAD_FLUSH_ENTRIES);
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            m_buffers.push_back(holder.buffer);
+        }
+        return *holder.buffer;
+    }
+
+    // 将记录追加到当前线程的缓冲区，按溢出策略处理缓冲区已满的情况
+    void stage(std::string&& data, uint64_t timestamp_ns) {
+        ThreadLogBuffer& buffer = localBuffer();
+        LogEntry entry;
+        entry.timestamp_ns = timestamp_ns;
+        entry.data = std::move(data);
+        
+        size_t size;
+        {
+            std::unique_lock<std::mutex> lock(buffer.mutex);
+            if (buffer.entries.size() >= m_capacity && m_policy == LOG_OVERFLOW_BLOCK) {
+                // 缓冲区已满：唤醒后台线程，阻塞到它取走记录，不占用CPU空转
+                lock.unlock();
+                wakeWriter();
+                lock.lock();
+                buffer.drained.wait(lock, [&]() { return buffer.entries.size() < m_capacity || m_stopWriter; });
+            }
+            size = buffer.entries.size();
+            if (size >= m_capacity) {
+                m_dropped++;
+                return;
+            }
+            buffer.entries.push_back(std::move(entry));
+            size++;
+        }
+        if (size >= LOG_THREAD_FLUSH_ENTRIES && m_writerIdle) {
+            wakeWriter();
+        }
+    }
+
+    // 把所有线程缓冲区中的记录追加到out；多个来源时按时间戳合并，保持全局时间顺序
+    void collect(std::vector<LogEntry>& out) {
+        size_t sources = out.empty() ? 0 : 1;   // 上一轮留下的记录也算一个来源
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        for (size_t i = 0; i < m_buffers.size(); ) {
+            ThreadLogBuffer& buffer = *m_buffers[i];
+            bool orphaned = buffer.orphaned;
+            // 持锁期间只交换容器，不让记录日志的线程等待元素搬移
+            std::vector<LogEntry> taken;
+            {
+                std::lock_guard<std::mutex> buffer_lock(buffer.mutex);
+                taken.swap(buffer.entries);
+            }
+            if (!taken.empty()) {
+                buffer.drained.notify_all();
+            }
+            if (!taken.empty()) {
+                sources++;
+                std::move(taken.begin(), taken.end(), std::back_inserter(out));
+            }
+            if (orphaned) {
+                m_buffers[i] = m_buffers.back();
+                m_buffers.pop_back();
+            } else {
+                i++;
+            }
+        }
+        // 每个线程内的记录本身有序，只有来自多个线程时才需要排序
+        if (sources > 1) {
+            std::stable_sort(out.begin(), out.end(), [](const LogEntry& a, const LogEntry& b) {
+                return a.timestamp_ns < b.timestamp_ns;
+            });
+        }
+    }
+
+    void wakeWriter() {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeCond.notify_one();
+    }
+
+    // 停止后台线程，队列中剩余记录写完后返回
+    void stopWriter() {
+        if (!m_async || !m_writer.joinable()) {
+            return;
+        }
+        m_stopWriter = true;
+        wakeWriter();
+        m_writer.join();
+        // 后台线程已退出，仍在等待缓冲区的线程放弃记录
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            std::lock_guard<std::mutex> buffer_lock(m_buffers[i]->mutex);
+            m_buffers[i]->drained.notify_all();
+        }
+    }
+
+    // 后台写线程：定期收集各线程缓冲区，一批只写一次文件、刷新一次
+    void writerLoop() {
+        uint64_t reportedDropped = 0;
+        std::vector<LogEntry> entries;
+        std::string batch;
+        while (true) {
+            batch.clear();
+            collect(entries);
+            
+            // 最近LOG_MERGE_WINDOW_NS内的记录留到下一轮：别的线程可能已取得更早的时间戳但还没放入缓冲区
+            bool stopping = m_stopWriter;
+            size_t count = entries.size();
+            if (!stopping) {
+                uint64_t cutoff = monotonicNs() - LOG_MERGE_WINDOW_NS;
+                while (count > 0 && entries[count - 1].timestamp_ns > cutoff) {
+                    count--;
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                batch += entries[i].data;
+                if (!m_binary) {
+                    batch += '\n';
+                }
+            }
+            entries.erase(entries.begin(), entries.begin() + count);
+            
+            uint64_t dropped = m_dropped;
+            if (m_policy == LOG_OVERFLOW_COUNT && dropped != reportedDropped) {
+                std::string notice = "日志缓冲区已满，丢弃 " + std::to_string(dropped - reportedDropped) + " 条日志";
+                if (m_binary) {
+                    batch += encodeRecord(LOGF_TEXT, WARNING, 1, [&](std::string& out) {
+                        LogEncodeArg(out, notice);
+                    });
+                } else {
+                    batch += getCurrentTimestamp() + " [警告] " + notice + "\n";
+                }
+                reportedDropped = dropped;
+            }
+            
+            if (!batch.empty()) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_logFile.Write(batch.data(), batch.size());
+                m_logFile.Flush();
+                m_written += count;
+                m_batches++;
+                continue;
+            }
+            
+            // 没有可写的记录：收到停止请求则退出，否则等待唤醒或到达收集间隔
+            if (stopping) {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_writerIdle = true;
+            if (!m_stopWriter) {
+                m_wakeCond.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+            }
+            m_writerIdle = false;
+        }
+    }
+
+    LogSegmentFile m_logFile;  // 分段日志文件
+    LogRotationPolicy m_rotation;  // 轮转策略
+    std::atomic<LogLevel> m_consoleLevel;   // 控制台日志级别
+    std::atomic<LogLevel> m_fileLevel;      // 文件日志级别
+    std::atomic<bool> m_fileOpen;           // 日志文件是否已打开
+    bool m_binary;                          // 是否以二进制格式写入文件
+    std::mutex m_mutex;        // 保护日志文件（同步模式下的写入、打开与关闭）
+    std::mutex m_consoleMutex; // 控制台输出锁，避免多线程输出交错
+
+    // 异步模式
+    std::atomic<bool> m_async;                        // 是否已启用异步模式
+    size_t m_capacity;                                // 每个线程缓冲区的容量
+    LogOverflowPolicy m_policy;                       // 缓冲区已满时的处理策略
+    std::vector<std::shared_ptr<ThreadLogBuffer> > m_buffers;  // 已登记的线程缓冲区
+    mutable std::mutex m_registryMutex;               // 保护m_buffers，只在线程登记和后台收集时使用
+    std::thread m_writer;                             // 后台写线程
+    std::atomic<bool> m_stopWriter;                   // 请求后台线程退出
+    std::atomic<bool> m_writerIdle;                   // 后台线程是否在等待
+    std::mutex m_wakeMutex;                           // 唤醒后台线程用
+    std::condition_variable m_wakeCond;
+
+    // 统计
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_batches;
 };
 
 // 方便使用的宏
+// 先判断级别再求值参数：被过滤掉的日志只有一次比较的开销，不会构造消息字符串
+#define LOG_ENABLED(level) ((level) >= LOG_MIN_LEVEL && Logger::getInstance().isEnabled(level))
+#define LOG_AT(level, message) \
+    do { if (LOG_ENABLED(level)) Logger::getInstance().log(level, message); } while (0)
+#define LOG_ATF(level, ...) \
+    do { if (LOG_ENABLED(level)) Logger::getInstance().logf(level, __VA_ARGS__); } while (0)
+
 #define LOG_INIT(filename, consoleLevel, fileLevel) Logger::getInstance().init(filename, consoleLevel, fileLevel)
-#define LOG_DEBUG(message) Logger::getInstance().debug(message)
-#define LOG_INFO(message) Logger::getInstance().info(message)
-#define LOG_WARNING(message) Logger::getInstance().warning(message)
-#define LOG_ERROR(message) Logger::getInstance().error(message)
+#define LOG_ENABLE_ASYNC(capacity, policy) Logger::getInstance().enableAsync(capacity, policy)
+#define LOG_DEBUG(message) LOG_AT(DEBUG, message)
+#define LOG_INFO(message) LOG_AT(INFO, message)
+#define LOG_WARNING(message) LOG_AT(WARNING, message)
+#define LOG_ERROR(message) LOG_AT(ERROR, message)
+#define LOG_DEBUGF(...) LOG_ATF(DEBUG, __VA_ARGS__)
+#define LOG_INFOF(...) LOG_ATF(INFO, __VA_ARGS__)
+#define LOG_WARNINGF(...) LOG_ATF(WARNING, __VA_ARGS__)
+#define LOG_ERRORF(...) LOG_ATF(ERROR, __VA_ARGS__)
+#define LOG_RECORD(level, id, ...) \
+    do { if (LOG_ENABLED(level)) Logger::getInstance().logRecord(level, id, __VA_ARGS__); } while (0)
+#define LOG_ENABLE_BINARY() Logger::getInstance().enableBinary()
 #define LOG_CLOSE() Logger::getInstance().close()
 
-#endif // LOGGER_H
\ No newline at end of file
+#endif // LOGGER_H
@@ -1,16 +1,178 @@
 #include "tcp_socket.h"
+#include "chat_server.h"
+#include "admin_server.h"
 #include <ctype.h>
 
+// 把日志队列、加密线程池与消息缓冲池的当前状态写入仪表，在每次导出指标前调用
+static void CollectQueueMetrics() {
+    MetricsRegistry& registry = MetricsRegistry::GetInstance();
+    static MetricGauge& log_depth = registry.Gauge("log_queue_depth", "日志缓冲区中尚未写入的记录数");
+    static MetricGauge& log_dropped = registry.Gauge("log_dropped_records", "因缓冲区已满被丢弃的日志记录数");
+    static MetricGauge& pool_depth = registry.Gauge("crypto_pool_queue_depth", "加密线程池排队任务数");
+    static MetricGauge& pool_peak = registry.Gauge("crypto_pool_queue_peak", "加密线程池历史最大排队任务数");
+    static MetricGauge& pool_completed = registry.Gauge("crypto_pool_completed_tasks", "加密线程池已完成任务数");
+    static MetricGauge& buffer_allocs = registry.Gauge("buffer_pool_allocs", "消息缓冲池分配次数");
+    static MetricGauge& buffer_hits = registry.Gauge("buffer_pool_hits", "由线程缓存或共享空闲链表满足的分配次数");
+    static MetricGauge& buffer_held = registry.Gauge("buffer_pool_bytes_held", "消息缓冲池持有的内存（字节）");
+    static MetricGauge& buffer_in_use = registry.Gauge("buffer_pool_bytes_in_use", "已分配出去的缓冲区内存（字节）");
+
+    LoggerStats log_stats = Logger::getInstance().getStats();
+    log_depth.Set(log_stats.queue_depth);
+    log_dropped.Set(log_stats.dropped);
+    CryptoPoolStats pool_stats = CryptoWorkerPool::GetInstance().GetStats();
+    pool_depth.Set(pool_stats.queue_depth);
+    pool_peak.Set(pool_stats.peak_depth);
+    pool_completed.Set(pool_stats.completed);
+    BufferPoolStats buffer_stats = BufferPool::GetInstance().GetStats();
+    buffer_allocs.Set(buffer_stats.allocs);
+    buffer_hits.Set(buffer_stats.cache_hits + buffer_stats.central_hits);
+    buffer_held.Set(buffer_stats.bytes_held);
+    buffer_in_use.Set(buffer_stats.bytes_in_use);
+}
+
+// 管理端口：CHATROOM_ADMIN=127.0.0.1:9100（或端口号、unix:/path）时在独立线程上提供Prometheus格式的指标
+static void StartAdminServer() {
+    static AdminServer admin;
+    const char* admin_address = getenv("CHATROOM_ADMIN");
+    if (admin_address != NULL) {
+        MetricsRegistry::GetInstance().AddCollector(CollectQueueMetrics);
+        if (admin.Start(admin_address)) {
+            printf("管理端口已启动: %s\n", admin_address);
+        } else {
+            fprintf(stderr, "管理端口启动失败: %s\n", admin_address);
+        }
+    }
+}
+
+// 流量捕获：CHATROOM_CAPTURE=文件名时记录每个连接的握手、收到的帧类型与长度，用chatreplay回放
+static void StartCapture() {
+    const char* capture_path = getenv("CHATROOM_CAPTURE");
+    if (capture_path != NULL) {
+        if (CaptureWriter::GetInstance().Open(capture_path)) {
+            printf("流量捕获已启动: %s\n", capture_path);
+        } else {
+            fprintf(stderr, "流量捕获启动失败: %s\n", capture_path);
+        }
+    }
+}
+
 int main() {
     char choice;
     CTcpSocket socket;
     
+    // CHATROOM_TRACE=1（或区间数）时记录握手与消息处理各阶段的区间，收到SIGUSR1时导出为
+    // Chrome trace JSON；须在启动任何线程之前设置，以便信号只由导出线程接收
+    const char* trace = getenv("CHATROOM_TRACE");
+    if (trace != NULL && atoi(trace) > 0) {
+        TraceRecorder& recorder = TraceRecorder::GetInstance();
+        recorder.Enable(atoi(trace) > 1 ? atoi(trace) : TRACE_CAPACITY);
+        recorder.DumpOnSignal("chatroom_trace_" + std::to_string(getpid()) + ".json");
+    }
+    
+    // 设置环境变量CHATROOM_RSA_TRACE后输出RSA计算过程（教学演示用），默认不输出
+    static StdoutTraceSink rsa_trace;
+    if (getenv("CHATROOM_RSA_TRACE") != NULL) {
+        RSA::SetTraceSink(&rsa_trace);
+    }
+    
+    // 换钥阈值：CHATROOM_REKEY_BYTES（字节）、CHATROOM_REKEY_SECONDS（秒），0表示关闭该条件
+    const char* rekey_bytes = getenv("CHATROOM_REKEY_BYTES");
+    const char* rekey_seconds = getenv("CHATROOM_REKEY_SECONDS");
+    socket.SetRekeyPolicy(rekey_bytes ? strtoull(rekey_bytes, NULL, 10) : REKEY_BYTES,
+                          rekey_seconds ? atoi(rekey_seconds) : REKEY_SECONDS);
+    
+    // CHATROOM_PING_INTERVAL_MS：聊天期间按该间隔发送延迟探测帧，结果计入chat_ping_*直方图
+    const char* ping_interval = getenv("CHATROOM_PING_INTERVAL_MS");
+    if (ping_interval != NULL) {
+        socket.SetProbeInterval(atoi(ping_interval));
+    }
+
+    // CHATROOM_BULK_CHUNK：批量数据的块大小（字节），聊天消息最多等待一块写完
+    const char* bulk_chunk = getenv("CHATROOM_BULK_CHUNK");
+    if (bulk_chunk != NULL) {
+        socket.SetBulkChunkSize(atoi(bulk_chunk));
+    }
+
+    // CHATROOM_RECV_DIR：/send收到的文件存放的目录，默认为received
+    const char* recv_dir = getenv("CHATROOM_RECV_DIR");
+    if (recv_dir != NULL) {
+        socket.SetReceiveDir(recv_dir);
+    }
+
+    // CHATROOM_LOG_FORMAT=binary时以二进制格式写日志（文件名追加.bin），用logdecode查看
+    const char* log_format = getenv("CHATROOM_LOG_FORMAT");
+    if (log_format != NULL && strcmp(log_format, "binary") == 0) {
+        LOG_ENABLE_BINARY();
+    }
+    
+    // 日志轮转：CHATROOM_LOG_MAX_BYTES（分段大小，0为不限）、CHATROOM_LOG_MAX_SECONDS（分段时长，0为不限）、
+    // CHATROOM_LOG_RETENTION（保留的历史分段数）、CHATROOM_LOG_MMAP=1（内存映射写入当前分段）
+    LogRotationPolicy rotation;
+    const char* log_max_bytes = getenv("CHATROOM_LOG_MAX_BYTES");
+    const char* log_max_seconds = getenv("CHATROOM_LOG_MAX_SECONDS");
+    const char* log_retention = getenv("CHATROOM_LOG_RETENTION");
+    const char* log_mmap = getenv("CHATROOM_LOG_MMAP");
+    if (log_max_bytes != NULL) {
+        rotation.max_bytes = strtoull(log_max_bytes, NULL, 10);
+    }
+    if (log_max_seconds != NULL) {
+        rotation.max_seconds = atoi(log_max_seconds);
+    }
+    if (log_retention != NULL) {
+        rotation.retention = atoi(log_retention);
+    }
+    rotation.use_mmap = log_mmap != NULL && strcmp(log_mmap, "1") == 0;
+    Logger::getInstance().setRotation(rotation);
+    
+    // 日志写入方式：CHATROOM_LOG_ASYNC=block（默认）/drop/count为异步写入并指定队列满时的策略，sync为同步写入
+    const char* log_mode = getenv("CHATROOM_LOG_ASYNC");
+    if (log_mode == NULL || strcmp(log_mode, "block") == 0) {
+        LOG_ENABLE_ASYNC(LOG_ASYNC_CAPACITY, LOG_OVERFLOW_BLOCK);
+    } else if (strcmp(log_mode, "drop") == 0) {
+        LOG_ENABLE_ASYNC(LOG_ASYNC_CAPACITY, LOG_OVERFLOW_DROP);
+    } else if (strcmp(log_mode, "count") == 0) {
+        LOG_ENABLE_ASYNC(LOG_ASYNC_CAPACITY, LOG_OVERFLOW_COUNT);
+    }
+
     // 用户选择运行模式
-    printf("选择运行模式 - 服务器(S) 或 客户端(C):\n");
+    printf("选择运行模式 - 服务器(S) 或 客户端(C) 或 多会话服务器(M) 或 RSA自检(T):\n");
     scanf("%c", &choice);
     getchar(); // 消耗换行符
     
-    if (choice == 's' || choice == 'S') {
+    if (choice == 't' || choice == 'T') {
+        // RSA自检：使用较小的素数便于观察
+        RSA test_rsa;
+        test_rsa.GenerateKeys(8);
+        return RSA::SelfTest(test_rsa, std::cout) ? 0 : 1;
+    } else if (choice == 'm' || choice == 'M') {
+        // 多会话服务器：并发处理多个客户端并转发聊天消息，不读取控制台输入（压力测试用）
+        // CHATROOM_MAX_SESSIONS指定最大并发会话数；CHATROOM_HANDSHAKE_TIMEOUT_MS、CHATROOM_IDLE_TIMEOUT_MS、
+        // CHATROOM_HEARTBEAT_MS指定握手时长上限、空闲超时与心跳间隔（毫秒），0表示关闭；
+        // CHATROOM_RATE_MSGS、CHATROOM_RATE_BYTES指定每个连接每秒的帧数与字节数上限，0表示不限
+        const char* max_sessions = getenv("CHATROOM_MAX_SESSIONS");
+        const char* handshake_timeout = getenv("CHATROOM_HANDSHAKE_TIMEOUT_MS");
+        const char* idle_timeout = getenv("CHATROOM_IDLE_TIMEOUT_MS");
+        const char* heartbeat = getenv("CHATROOM_HEARTBEAT_MS");
+        const char* rate_msgs = getenv("CHATROOM_RATE_MSGS");
+        const char* rate_bytes = getenv("CHATROOM_RATE_BYTES");
+        StartAdminServer();
+        StartCapture();
+        CChatServer server;
+        server.SetTimeouts(handshake_timeout ? atoi(handshake_timeout) : CHAT_SERVER_HANDSHAKE_TIMEOUT_MS,
+                           idle_timeout ? atoi(idle_timeout) : SESSION_IDLE_TIMEOUT_MS,
+                           heartbeat ? atoi(heartbeat) : SESSION_HEARTBEAT_MS);
+        server.SetRateLimit(rate_msgs ? atoi(rate_msgs) : SESSION_RATE_MSGS,
+                            rate_bytes ? atoi(rate_bytes) : SESSION_RATE_BYTES);
+        server.SetRekeyPolicy(rekey_bytes ? strtoull(rekey_bytes, NULL, 10) : REKEY_BYTES,
+                              rekey_seconds ? atoi(rekey_seconds) : REKEY_SECONDS);
+        if (!server.Start(DEFAULT_PORT, max_sessions ? atoi(max_sessions) : CHAT_SERVER_MAX_SESSIONS)) {
+            fprintf(stderr, "服务器初始化失败\n");
+            return 1;
+        }
+        printf("多会话服务器已启动，端口 %d\n", DEFAULT_PORT);
+        server.Run();
+        return 1;
+    } else if (choice == 's' || choice == 'S') {
         // 服务器模式
         printf("启动服务器模式...\n");
         if (!socket.InitServer()) {
@@ -18,22 +180,29 @@ int main() {
             return 1;
         }
         
+        StartAdminServer();
+        StartCapture();
+        
         printf("开始监听客户端连接...\n");
         if (!socket.StartListen()) {
             fprintf(stderr, "启动监听失败\n");
             return 1;
         }
         
-        printf("等待客户端连接...\n");
-        // 接受客户端连接
-        if (socket.AcceptConnection() < 0) {
-            fprintf(stderr, "接受连接失败\n");
-            return 1;
+        // 会话结束后继续接受连接，客户端重连时可凭会话票据恢复
+        while (1) {
+            printf("等待客户端连接...\n");
+            // 接受客户端连接
+            if (socket.AcceptConnection() < 0) {
+                fprintf(stderr, "接受连接失败\n");
+                return 1;
+            }
+            
+            // 启动安全通信（包含RSA密钥交换）
+            printf("开始RSA密钥交换和DES加密通信...\n");
+            socket.StartSecureServer();
+            socket.CloseClientSocket();
         }
-        
-        // 启动安全通信（包含RSA密钥交换）
-        printf("开始RSA密钥交换和DES加密通信...\n");
-        socket.StartSecureServer();
     } else if (choice == 'c' || choice == 'C') {
         // 客户端模式
         char server_ip[64] = {0};
@@ -61,7 +230,21 @@ int main() {
             return 1;
         }
         
-        // 连接到服务器
+        // 可选的第一条消息，随密钥交换一起发送，省去一次往返
+        char first_msg[BUFFER_SIZE] = {0};
+        printf("请输入第一条消息（可留空，将随密钥交换一并发送）:\n");
+        if (fgets(first_msg, sizeof(first_msg), stdin) != NULL) {
+            int msg_len = strlen(first_msg);
+            if (msg_len > 0 && first_msg[msg_len - 1] == '\n') {
+                first_msg[--msg_len] = '\0';
+            }
+            if (msg_len > 0) {
+                socket.SetEarlyData(first_msg, msg_len);
+            }
+        }
+        
+        // 连接到服务器，内核支持时使用TCP Fast Open让握手数据随SYN发出
+        socket.SetFastOpen(true);
         if (!socket.ConnectToServer(server_ip)) {
             fprintf(stderr, "连接服务器失败\n");
             return 1;
@@ -71,7 +254,7 @@ int main() {
         printf("开始RSA密钥交换和DES加密通信...\n");
         socket.StartSecureClient();
     } else {
-        fprintf(stderr, "无效选择。请输入'S'表示服务器或'C'表示客户端。\n");
+        fprintf(stderr, "无效选择。请输入'S'表示服务器、'C'表示客户端、'M'表示多会话服务器或'T'表示RSA自检。\n");
         return 1;
     }
     
@@ -0,0 +1,353 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define METRIC_SHARDS 8             // 计数器分片数
+#define HISTOGRAM_SHARDS 4          // 直方图分片数
+#define HISTOGRAM_SUB_BITS 4        // 每个2的幂区间再细分为16个桶，相对误差约6%
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// 当前线程使用的分片下标：线程第一次记录指标时按顺序分配
+inline int MetricShardIndex() {
+    static std::atomic<int> next_shard(0);
+    static thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+
+// 计数器：只增不减，每个线程写自己的分片（各占一个缓存行），读取时求和
+class MetricCounter {
+public:
+    MetricCounter() {
+        for (int i = 0; i < METRIC_SHARDS; i++) {
+            m_shards[i].value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Add(uint64_t n) {
+        m_shards[MetricShardIndex() % METRIC_SHARDS].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    void Inc() { Add(1); }
+
+    uint64_t Value() const {
+        uint64_t sum = 0;
+        for (int i = 0; i < METRIC_SHARDS; i++) {
+            sum += m_shards[i].value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> value;
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    Shard m_shards[METRIC_SHARDS];
+};
+
+// 仪表：可增可减的当前值，如活动连接数
+class MetricGauge {
+public:
+    MetricGauge() : m_value(0) {}
+
+    void Set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void Add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t Value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+// 直方图快照
+struct HistogramSnapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    std::vector<uint64_t> buckets;      // 各桶计数（未累加）
+
+    // 分位数q（0~1）对应的桶上界
+    uint64_t Percentile(double q) const;
+};
+
+// HDR风格的对数-线性直方图：小于16的值各占一个桶，之后每个2的幂区间分为16个桶，
+// 覆盖整个uint64范围，记录只是一次位运算和两三次原子加法
+class MetricHistogram {
+public:
+    MetricHistogram() {
+        for (int s = 0; s < HISTOGRAM_SHARDS; s++) {
+            m_shards[s].count.store(0, std::memory_order_relaxed);
+            m_shards[s].sum.store(0, std::memory_order_relaxed);
+            m_shards[s].max.store(0, std::memory_order_relaxed);
+            for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                m_shards[s].buckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Record(uint64_t value) {
+        Shard& shard = m_shards[MetricShardIndex() % HISTOGRAM_SHARDS];
+        shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    HistogramSnapshot Snapshot() const {
+        HistogramSnapshot snapshot;
+        snapshot.count = 0;
+        snapshot.sum = 0;
+        snapshot.max = 0;
+        snapshot.buckets.assign(HISTOGRAM_BUCKETS, 0);
+        for (int s = 0; s < HISTOGRAM_SHARDS; s++) {
+            snapshot.count += m_shards[s].count.load(std::memory_order_relaxed);
+            snapshot.sum += m_shards[s].sum.load(std::memory_order_relaxed);
+            uint64_t max = m_shards[s].max.load(std::memory_order_relaxed);
+            if (max > snapshot.max) {
+                snapshot.max = max;
+            }
+            for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                snapshot.buckets[i] += m_shards[s].buckets[i].load(std::memory_order_relaxed);
+            }
+        }
+        return snapshot;
+    }
+
+    static int BucketIndex(uint64_t value) {
+        if (value < (1u << HISTOGRAM_SUB_BITS)) {
+            return (int)value;
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        int shift = exponent - HISTOGRAM_SUB_BITS;
+        return ((shift + 1) << HISTOGRAM_SUB_BITS) + (int)((value >> shift) & ((1u << HISTOGRAM_SUB_BITS) - 1));
+    }
+
+    // 桶内的最大值
+    static uint64_t BucketUpperBound(int index) {
+        if (index < (1 << HISTOGRAM_SUB_BITS)) {
+            return index;
+        }
+        int shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+        uint64_t sub = index & ((1 << HISTOGRAM_SUB_BITS) - 1);
+        uint64_t lower = ((1ULL << HISTOGRAM_SUB_BITS) + sub) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    };
+    Shard m_shards[HISTOGRAM_SHARDS];
+};
+
+inline uint64_t HistogramSnapshot::Percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = MetricHistogram::BucketUpperBound(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+// 计时器：构造时开始计时
+class MetricStopwatch {
+public:
+    MetricStopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    uint64_t ElapsedNs() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+    }
+    uint64_t ElapsedUs() const { return ElapsedNs() / 1000; }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// 指标注册表
+// 指标在第一次使用时按名称注册，之后一直存在；调用方应把返回的引用保存在静态变量中，
+// 记录时不再经过注册表，不加锁。
+class MetricsRegistry {
+public:
+    enum MetricType {
+        METRIC_COUNTER,
+        METRIC_GAUGE,
+        METRIC_HISTOGRAM
+    };
+
+    // 注册表中的一项
+    struct Metric {
+        MetricType type;
+        std::string name;
+        std::string help;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    static MetricsRegistry& GetInstance() {
+        static MetricsRegistry instance;
+        return instance;
+    }
+
+    MetricCounter& Counter(const std::string& name, const std::string& help) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Metric& metric = Find(name, help, METRIC_COUNTER);
+        if (!metric.counter) {
+            metric.counter.reset(new MetricCounter());
+        }
+        return *metric.counter;
+    }
+
+    MetricGauge& Gauge(const std::string& name, const std::string& help) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Metric& metric = Find(name, help, METRIC_GAUGE);
+        if (!metric.gauge) {
+            metric.gauge.reset(new MetricGauge());
+        }
+        return *metric.gauge;
+    }
+
+    MetricHistogram& Histogram(const std::string& name, const std::string& help) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Metric& metric = Find(name, help, METRIC_HISTOGRAM);
+        if (!metric.histogram) {
+            metric.histogram.reset(new MetricHistogram());
+        }
+        return *metric.histogram;
+    }
+
+    // 登记采集函数：导出前调用，用于把队列深度等只能现查的状态写入仪表
+    void AddCollector(std::function<void()> collector) {
+        std::lock_guard<std::mutex> lock(m_collectorMutex);
+        m_collectors.push_back(collector);
+    }
+
+    void Collect() {
+        std::lock_guard<std::mutex> lock(m_collectorMutex);
+        for (size_t i = 0; i < m_collectors.size(); i++) {
+            m_collectors[i]();
+        }
+    }
+
+    // 按名称顺序访问所有指标
+    template <typename F>
+    void ForEach(F visit) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::map<std::string, Metric>::iterator it = m_metrics.begin(); it != m_metrics.end(); ++it) {
+            visit(it->second);
+        }
+    }
+
+    // 每个指标一行的文本摘要，直方图给出次数、平均值与分位数
+    std::string Summary() {
+        std::string out;
+        ForEach([&out](const Metric& metric) {
+            char line[256];
+            if (metric.type == METRIC_COUNTER) {
+                snprintf(line, sizeof(line), "%s %llu\n", metric.name.c_str(),
+                         (unsigned long long)metric.counter->Value());
+            } else if (metric.type == METRIC_GAUGE) {
+                snprintf(line, sizeof(line), "%s %lld\n", metric.name.c_str(),
+                         (long long)metric.gauge->Value());
+            } else {
+                HistogramSnapshot snapshot = metric.histogram->Snapshot();
+                snprintf(line, sizeof(line), "%s count=%llu avg=%.1f p50=%llu p99=%llu max=%llu\n",
+                         metric.name.c_str(), (unsigned long long)snapshot.count,
+                         snapshot.count ? (double)snapshot.sum / snapshot.count : 0.0,
+                         (unsigned long long)snapshot.Percentile(0.5),
+                         (unsigned long long)snapshot.Percentile(0.99),
+                         (unsigned long long)snapshot.max);
+            }
+            out += line;
+        });
+        return out;
+    }
+
+    // Prometheus文本格式（0.0.4）的快照，直方图以summary类型给出分位数、总和与次数
+    std::string PrometheusText() {
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        Collect();
+        std::string out;
+        ForEach([&out](const Metric& metric) {
+            char line[256];
+            out += "# HELP " + metric.name + " " + metric.help + "\n";
+            if (metric.type == METRIC_COUNTER) {
+                snprintf(line, sizeof(line), "# TYPE %s counter\n%s %llu\n", metric.name.c_str(),
+                         metric.name.c_str(), (unsigned long long)metric.counter->Value());
+                out += line;
+            } else if (metric.type == METRIC_GAUGE) {
+                snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %lld\n", metric.name.c_str(),
+                         metric.name.c_str(), (long long)metric.gauge->Value());
+                out += line;
+            } else {
+                HistogramSnapshot snapshot = metric.histogram->Snapshot();
+                out += "# TYPE " + metric.name + " summary\n";
+                for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+                    snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %llu\n", metric.name.c_str(),
+                             quantiles[i], (unsigned long long)snapshot.Percentile(quantiles[i]));
+                    out += line;
+                }
+                snprintf(line, sizeof(line), "%s_sum %llu\n%s_count %llu\n",
+                         metric.name.c_str(), (unsigned long long)snapshot.sum,
+                         metric.name.c_str(), (unsigned long long)snapshot.count);
+                out += line;
+            }
+        });
+        return out;
+    }
+
+private:
+    MetricsRegistry() {}
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // 查找或创建指标，调用方持有m_mutex并在锁内创建对应类型的实例。
+    // 同名指标的类型必须一致：类型不符时报错，调用方得到的实例不导出，不影响已注册的指标
+    Metric& Find(const std::string& name, const std::string& help, MetricType type) {
+        Metric& metric = m_metrics[name];
+        if (metric.name.empty()) {
+            metric.type = type;
+            metric.name = name;
+            metric.help = help;
+        } else if (metric.type != type) {
+            fprintf(stderr, "指标 %s 已按其他类型注册，本次注册不会被导出\n", name.c_str());
+            m_conflicts.push_back(Metric());
+            m_conflicts.back().type = type;
+            m_conflicts.back().name = name;
+            return m_conflicts.back();
+        }
+        return metric;
+    }
+
+    std::map<std::string, Metric> m_metrics;   // 按名称排序，输出顺序稳定
+    std::deque<Metric> m_conflicts;            // 类型与已注册指标冲突的实例，只供调用方使用
+    std::mutex m_mutex;                        // 保护注册（含创建实例）与遍历
+    std::vector<std::function<void()> > m_collectors;
+    std::mutex m_collectorMutex;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,132 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// 握手协议常量
+#define HELLO_MAGIC 0x43484154      // "CHAT"，用于识别合法的握手消息
+#define TICKET_BLOB_SIZE 32         // 加密会话票据长度（4个DES分组）
+#define HELLO_NONCE_SIZE 8          // 问候消息中的随机数长度，票据恢复时用于导出新的会话密钥
+
+// 客户端握手模式
+enum HelloMode {
+    HELLO_FULL = 1,     // 完整RSA密钥交换
+    HELLO_RESUME = 2    // 使用会话票据恢复，跳过RSA
+};
+
+// 客户端问候消息：连接建立后由客户端首先发送
+// 所有整数字段均为网络字节序
+struct ClientHello {
+    uint32_t magic;                              // HELLO_MAGIC
+    uint32_t mode;                               // HelloMode
+    unsigned char ticket[TICKET_BLOB_SIZE];      // 会话票据（仅HELLO_RESUME有效）
+    unsigned char nonce[HELLO_NONCE_SIZE];       // 客户端随机数（仅HELLO_RESUME有效）
+    uint32_t early_len;                          // 紧随其后的0-RTT消息帧长度，0表示没有
+    uint32_t reserved;
+};
+
+// 服务端应答：告知客户端实际采用的握手模式
+struct ServerHello {
+    uint32_t magic;                              // HELLO_MAGIC
+    uint32_t mode;                               // HelloMode
+    unsigned char nonce[HELLO_NONCE_SIZE];       // 服务端随机数（仅HELLO_RESUME有效）
+};
+
+// 完整握手中客户端发送的密钥交换消息，可在其后附带第一条加密消息帧
+struct KeyExchange {
+    uint64_t encrypted_key[4];                   // RSA加密的DES密钥（每块2字节，大端序）
+    uint32_t early_len;                          // 紧随其后的消息帧长度（网络字节序），0表示没有
+    uint32_t reserved;
+};
+
+// 完整握手结束后服务端下发的新票据，整体使用会话DES密钥加密
+struct TicketGrant {
+    int64_t expiry;                              // 过期时间（UNIX秒）
+    unsigned char ticket[TICKET_BLOB_SIZE];      // 不透明票据，只有服务端能解开
+};
+
+// 消息帧：帧头 + DES密文，密文长度为8的倍数
+#define FRAME_MAX_PAYLOAD 65536     // 协议允许的最大载荷长度
+
+// 帧类型
+enum FrameType {
+    FRAME_CHAT = 1,     // 聊天消息
+    FRAME_REKEY = 2,    // 换钥控制帧，载荷为RekeyPayload
+    FRAME_PING = 3,     // 延迟探测帧，载荷为PingPayload
+    FRAME_ECHO = 4,     // 探测应答帧，原样带回PingPayload并填写对端接收时间
+    FRAME_BULK = 5,     // 批量数据块，载荷为BulkChunkHeader加数据
+    FRAME_FILE = 6      // 文件传输控制帧，载荷为FileControl
+};
+
+// 帧头，整数字段均为网络字节序
+struct FrameHeader {
+    uint32_t length;                             // 载荷（密文）长度
+    uint8_t type;                                // FrameType
+    uint8_t flags;                               // 保留标志位
+    uint16_t reserved;
+    uint32_t seq;                                // 发送方向上的帧序号，用于确定换钥边界
+    uint32_t checksum;                           // 载荷逐字节累加和
+};
+
+// 换钥控制帧载荷（使用当前密钥加密）：
+// 序号不小于activate_seq的帧改用新密钥，之前的帧仍使用旧密钥
+struct RekeyPayload {
+    char key[8];                                 // 新DES密钥
+    uint32_t activate_seq;                       // 生效序号（网络字节序）
+    uint32_t reserved;
+};
+
+// 延迟探测帧载荷（与聊天消息一样加密）：时间戳均为纳秒，按大端序写入。
+// 往返时间只用发起方自己的单调时钟计算；单程时间比较两端的实时时钟，需要两端时钟同步（或同一台机器）
+struct PingPayload {
+    uint32_t probe_seq;                          // 探测序号（网络字节序）
+    uint32_t reserved;
+    unsigned char sent_mono[8];                  // 发起方发送时的单调时钟
+    unsigned char sent_real[8];                  // 发起方发送时的实时时钟
+    unsigned char peer_recv_real[8];             // 对端解密完成时的实时时钟，探测帧中为0
+};
+
+// 批量数据块载荷（加密）：块头之后是本块数据。大块数据拆成多个块帧发送，
+// 块之间可以插入控制帧与聊天消息；DES以零填充，数据长度以块头为准
+#define BULK_FLAG_LAST 0x1                           // 流的最后一块
+#define BULK_CHUNK_DEFAULT (16 * 1024)               // 默认块大小
+struct BulkChunkHeader {
+    uint32_t stream_id;                          // 流编号（网络字节序）
+    uint32_t length;                             // 本块数据长度（网络字节序）
+    unsigned char offset[8];                     // 本块在流中的偏移（大端序）
+    uint32_t flags;                              // BULK_FLAG_*（网络字节序）
+    uint32_t reserved;
+};
+#define BULK_CHUNK_MAX ((int)(FRAME_MAX_PAYLOAD - sizeof(BulkChunkHeader) - 8))   // 块大小上限，密文不超过FRAME_MAX_PAYLOAD
+
+// 文件传输：发送方发出FILE_OFFER，接收方以FILE_ACCEPT给出起始偏移（续传时为上次确认的偏移），
+// 数据以批量数据块发送（流编号与FileControl相同），接收方写入后定期回复FILE_ACK，收完后回复FILE_DONE；
+// 任何一方出错时发送FILE_ABORT
+enum FileOp {
+    FILE_OFFER = 1,
+    FILE_ACCEPT = 2,
+    FILE_ACK = 3,
+    FILE_DONE = 4,
+    FILE_ABORT = 5
+};
+
+#define FILE_NAME_MAX 256
+struct FileControl {
+    uint32_t stream_id;                          // 流编号（网络字节序）
+    uint32_t op;                                 // FileOp（网络字节序）
+    unsigned char size[8];                       // 文件大小（大端序）
+    unsigned char mtime[8];                      // 文件修改时间（UNIX秒，大端序），与名称、大小一起识别续传的文件
+    unsigned char offset[8];                     // FILE_ACCEPT为起始偏移，FILE_ACK/FILE_DONE为已写入的字节数（大端序）
+    char name[FILE_NAME_MAX];                    // 文件名（不含目录），以'\0'结尾
+};
+
+// 计算载荷校验和
+inline uint32_t FrameChecksum(const char* data, int len) {
+    uint32_t sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += (unsigned char)data[i];
+    }
+    return sum;
+}
+
+#endif // PROTOCOL_H
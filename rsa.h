@@ -6,6 +6,40 @@
 #include <random>
 #include <tuple>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <atomic>
+
+// 加密层跟踪输出接口，默认不安装任何输出（空输出）
+class CryptoTraceSink {
+public:
+    virtual ~CryptoTraceSink() {}
+    virtual void Write(const std::string& line) = 0;
+};
+
+// 输出到标准输出的跟踪实现，用于教学演示
+class StdoutTraceSink : public CryptoTraceSink {
+public:
+    void Write(const std::string& line) override {
+        std::cout << line << '\n';
+    }
+};
+
+// 跟踪宏：未安装输出时只有一次原子读取和分支，不做任何格式化；
+// 编译时定义 RSA_DISABLE_TRACE 可彻底移除跟踪代码
+#ifdef RSA_DISABLE_TRACE
+#define RSA_TRACE(expr) do { } while (0)
+#else
+#define RSA_TRACE(expr) \
+    do { \
+        CryptoTraceSink* rsa_trace_sink_ = RSA::GetTraceSink(); \
+        if (rsa_trace_sink_ != nullptr) { \
+            std::ostringstream rsa_trace_os_; \
+            rsa_trace_os_ << expr; \
+            rsa_trace_sink_->Write(rsa_trace_os_.str()); \
+        } \
+    } while (0)
+#endif
 
 class RSA {
 public:
@@ -19,6 +53,15 @@ public:
     
     RSA() : rng(std::random_device{}()) {}
     
+    // 安装跟踪输出，传入nullptr恢复为空输出；调用方负责sink的生命周期
+    static void SetTraceSink(CryptoTraceSink* sink) {
+        TraceSinkSlot().store(sink, std::memory_order_release);
+    }
+    
+    static CryptoTraceSink* GetTraceSink() {
+        return TraceSinkSlot().load(std::memory_order_acquire);
+    }
+    
     // 为验证需要，将IsPrime和gcd设为公有
     static uint64_t gcd(uint64_t a, uint64_t b) {
         while (b != 0) {
@@ -66,15 +109,15 @@ public:
         e = ChooseExponent();
         d = ModInverse(e, phi);
         
-        // 添加验证输出
-        std::cout << "\n=== RSA密钥生成验证 ===" << std::endl;
-        std::cout << "素数 p: " << p << " | 是否素数: " << IsPrime(p) << std::endl;
-        std::cout << "素数 q: " << q << " | 是否素数: " << IsPrime(q) << std::endl;
-        std::cout << "模数 n: " << n << " (p*q=" << p*q << ")" << std::endl;
-        std::cout << "欧拉函数 φ(n): " << phi << " (实际值: " << (p-1)*(q-1) << ")" << std::endl;
-        std::cout << "公钥指数 e: " << e << " (与φ(n)互质: " << (gcd(e,phi)==1) << ")" << std::endl;
-        std::cout << "私钥指数 d: " << d << std::endl;
-        std::cout << "验证 ed ≡1 mod φ(n): " << (e*d % phi) << std::endl;
+        // 验证输出（仅在安装跟踪输出时计算）
+        RSA_TRACE("\n=== RSA密钥生成验证 ===");
+        RSA_TRACE("素数 p: " << p << " | 是否素数: " << IsPrime(p));
+        RSA_TRACE("素数 q: " << q << " | 是否素数: " << IsPrime(q));
+        RSA_TRACE("模数 n: " << n << " (p*q=" << p*q << ")");
+        RSA_TRACE("欧拉函数 φ(n): " << phi << " (实际值: " << (p-1)*(q-1) << ")");
+        RSA_TRACE("公钥指数 e: " << e << " (与φ(n)互质: " << (gcd(e,phi)==1) << ")");
+        RSA_TRACE("私钥指数 d: " << d);
+        RSA_TRACE("验证 ed ≡1 mod φ(n): " << (e*d % phi));
     }
 
     PublicKey GetPublicKey() const { return {e, n}; }
@@ -86,65 +129,74 @@ public:
     uint64_t GetPhi() const { return phi; }
 
     static uint64_t Encrypt(uint64_t m, PublicKey pub) {
-        std::cout << "\n=== 加密过程 ===" << std::endl;
-        std::cout << "明文 M: " << m << std::endl;
-        std::cout << "使用公钥 (e,n): (" << pub.e << "," << pub.n << ")" << std::endl;
+        RSA_TRACE("\n=== 加密过程 ===");
+        RSA_TRACE("明文 M: " << m);
+        RSA_TRACE("使用公钥 (e,n): (" << pub.e << "," << pub.n << ")");
         
         uint64_t c = PowMod(m, pub.e, pub.n);
-        std::cout << "密文 C = M^e mod n = " 
+        RSA_TRACE("密文 C = M^e mod n = " 
                 << m << "^" << pub.e << " mod " << pub.n 
-                << " = " << c << std::endl;
+                << " = " << c);
         return c;
     }
 
     static uint64_t Decrypt(uint64_t c, PrivateKey priv) {
-        std::cout << "\n=== 解密过程 ===" << std::endl;
-        std::cout << "密文 C: " << c << std::endl;
-        std::cout << "使用私钥 (d,n): (" << priv.d << "," << priv.n << ")" << std::endl;
+        RSA_TRACE("\n=== 解密过程 ===");
+        RSA_TRACE("密文 C: " << c);
+        RSA_TRACE("使用私钥 (d,n): (" << priv.d << "," << priv.n << ")");
         
         uint64_t m = PowMod(c, priv.d, priv.n);
-        std::cout << "明文 M = C^d mod n = " 
+        RSA_TRACE("明文 M = C^d mod n = " 
                 << c << "^" << priv.d << " mod " << priv.n 
-                << " = " << m << std::endl;
+                << " = " << m);
         return m;
     }
     
-    // 添加边界值测试方法
-    static void TestEdgeCases(RSA& rsa) {
+    // 自检：边界值与往返加解密验证，结果写入out，全部通过返回true
+    // 只在用户显式请求时运行，不属于握手流程
+    static bool SelfTest(RSA& rsa, std::ostream& out) {
         auto pub = rsa.GetPublicKey();
         auto priv = rsa.GetPrivateKey();
+        bool passed = true;
         
-        std::cout << "\n=== 数学特殊值验证 ===" << std::endl;
+        out << "\n=== 数学特殊值验证 ===" << std::endl;
         
-        // 测试0加密
-        uint64_t zero = 0;
-        auto cipher = RSA::Encrypt(zero, pub);
-        auto decrypted = RSA::Decrypt(cipher, priv);
-        std::cout << "0加密测试: " << zero << " -> " << cipher << " -> " << decrypted << std::endl;
-
-        // 测试1加密
-        uint64_t one = 1;
-        cipher = RSA::Encrypt(one, pub);
-        decrypted = RSA::Decrypt(cipher, priv);
-        std::cout << "1加密测试: " << one << " -> " << cipher << " -> " << decrypted << std::endl;
-
-        // 测试n-1加密
-        uint64_t edge = pub.n - 1;
-        cipher = RSA::Encrypt(edge, pub);
-        decrypted = RSA::Decrypt(cipher, priv);
-        std::cout << "n-1加密测试: " << edge << " -> " << cipher << " -> " << decrypted << std::endl;
+        // 测试0、1、n-1及普通明文的往返加解密
+        const uint64_t samples[] = {0, 1, pub.n - 1, 42};
+        const char* names[] = {"0", "1", "n-1", "42"};
+        for (int i = 0; i < 4; i++) {
+            uint64_t cipher = RSA::Encrypt(samples[i], pub);
+            uint64_t decrypted = RSA::Decrypt(cipher, priv);
+            bool ok = decrypted == samples[i];
+            passed = passed && ok;
+            out << names[i] << "加密测试: " << samples[i] << " -> " << cipher << " -> " << decrypted
+                << (ok ? " [通过]" : " [失败]") << std::endl;
+        }
         
         // 理论验证输出
-        std::cout << "\n=== RSA数学原理验证 ===" << std::endl;
-        std::cout << "1. 0^e mod n = " << PowMod(0, pub.e, pub.n) << " (应为0)" << std::endl;
-        std::cout << "2. 1^e mod n = " << PowMod(1, pub.e, pub.n) << " (应为1)" << std::endl;
-        std::cout << "3. (n-1)^e mod n = " << PowMod(pub.n-1, pub.e, pub.n) << " (应为n-1)" << std::endl;
+        out << "\n=== RSA数学原理验证 ===" << std::endl;
+        uint64_t r0 = PowMod(0, pub.e, pub.n);
+        uint64_t r1 = PowMod(1, pub.e, pub.n);
+        uint64_t rn = PowMod(pub.n-1, pub.e, pub.n);
+        out << "1. 0^e mod n = " << r0 << " (应为0)" << std::endl;
+        out << "2. 1^e mod n = " << r1 << " (应为1)" << std::endl;
+        out << "3. (n-1)^e mod n = " << rn << " (应为n-1)" << std::endl;
+        passed = passed && r0 == 0 && r1 == 1 && rn == pub.n - 1;
+        
+        out << "\n自检" << (passed ? "通过" : "失败") << std::endl;
+        return passed;
     }
 
 private:
     uint64_t p, q, n, phi, e, d;
     std::mt19937_64 rng;
 
+    // 全局跟踪输出槽，握手可能在加密线程池中执行，因此使用原子指针
+    static std::atomic<CryptoTraceSink*>& TraceSinkSlot() {
+        static std::atomic<CryptoTraceSink*> sink(nullptr);
+        return sink;
+    }
+
     // 快速幂取模，修改为安全的大数乘法方式
     static uint64_t PowMod(uint64_t base, uint64_t exp, uint64_t mod) {
         uint64_t result = 1;
@@ -185,15 +237,15 @@ private:
     uint64_t ChooseExponent() {
         // 常用65537作为公钥指数
         if (phi > 65537 && gcd(65537, phi) == 1) {
-            std::cout << "使用标准公钥指数e=65537" << std::endl;
+            RSA_TRACE("使用标准公钥指数e=65537");
             return 65537;
         }
             
         // 如果65537不适合，从3开始寻找与phi互质的较小奇数
-        std::cout << "需要选择其他公钥指数e..." << std::endl;
+        RSA_TRACE("需要选择其他公钥指数e...");
         for (uint64_t e = 3; e < phi && e < UINT32_MAX; e += 2) {
             if (gcd(e, phi) == 1) {
-                std::cout << "已选择公钥指数e=" << e << std::endl;
+                RSA_TRACE("已选择公钥指数e=" << e);
                 return e;
             }
         }
@@ -0,0 +1,88 @@
+#ifndef SEND_LANES_H
+#define SEND_LANES_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include "metrics.h"
+#include "trace.h"
+
+// 发送通道，数值越小优先级越高
+enum SendLane {
+    LANE_CONTROL = 0,      // 换钥、探测与心跳
+    LANE_CHAT = 1,         // 交互聊天消息
+    LANE_BULK = 2,         // 批量数据，按块发送
+    LANE_COUNT = 3
+};
+
+// 各通道等待写入的时间直方图（纳秒，进程内所有连接共用）
+inline MetricHistogram& LaneWaitHistogram(int lane) {
+    static MetricHistogram* histograms[LANE_COUNT] = {
+        &MetricsRegistry::GetInstance().Histogram("chat_lane_control_wait_ns", "控制帧等待写入的时间（纳秒）"),
+        &MetricsRegistry::GetInstance().Histogram("chat_lane_chat_wait_ns", "聊天消息等待写入的时间（纳秒）"),
+        &MetricsRegistry::GetInstance().Histogram("chat_lane_bulk_wait_ns", "批量数据块等待写入的时间（纳秒）"),
+    };
+    return *histograms[lane];
+}
+
+// 一个连接发送方向的优先级锁
+// 每一帧（帧序号、加密与写入）都在锁内完成。锁空闲时直接获得；忙时按通道排队，释放后先交给控制帧，
+// 其次聊天消息，最后批量数据。批量数据每发送一块就释放一次，聊天消息最多等待正在写入的那一块，
+// 块大小决定了聊天被批量数据阻塞的上限。同一通道内不保证先后，调用方在一个线程上发送同一通道的数据。
+class SendLanes {
+public:
+    SendLanes() : m_busy(false) {
+        for (int i = 0; i < LANE_COUNT; i++) {
+            m_waiting[i] = 0;
+        }
+    }
+
+    void Lock(int lane) {
+        uint64_t start = TraceNowNs();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiting[lane]++;
+        m_ready.wait(lock, [&]() { return !m_busy && !HigherWaiting(lane); });
+        m_waiting[lane]--;
+        m_busy = true;
+        lock.unlock();
+        LaneWaitHistogram(lane).Record(TraceNowNs() - start);
+    }
+
+    void Unlock() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy = false;
+        }
+        m_ready.notify_all();
+    }
+
+private:
+    bool HigherWaiting(int lane) const {
+        for (int i = 0; i < lane; i++) {
+            if (m_waiting[i] > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    bool m_busy;                   // 是否有帧正在写入
+    int m_waiting[LANE_COUNT];     // 各通道等待写入的帧数
+};
+
+// 在作用域内持有一个通道
+class LaneGuard {
+public:
+    LaneGuard(SendLanes& lanes, int lane) : m_lanes(lanes) { m_lanes.Lock(lane); }
+    ~LaneGuard() { m_lanes.Unlock(); }
+
+private:
+    LaneGuard(const LaneGuard&) = delete;
+    LaneGuard& operator=(const LaneGuard&) = delete;
+
+    SendLanes& m_lanes;
+};
+
+#endif // SEND_LANES_H
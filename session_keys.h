@@ -0,0 +1,80 @@
+#ifndef SESSION_KEYS_H
+#define SESSION_KEYS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#include "des.h"
+
+// 双缓冲会话密钥：一个槽位保存当前密钥编排，另一个保存下一把（或上一把）密钥编排。
+// 换钥时新密钥提前展开到空闲槽位，到达生效序号时只需切换槽位下标，
+// 生效序号之前的帧仍使用旧槽位解密，因此换钥过程中不需要暂停收发。
+class SessionKeyRing {
+public:
+    SessionKeyRing() : m_active(0), m_pending(false), m_activate_seq(0), m_switch_seq(0), m_generation(0) {
+        memset(m_slots, 0, sizeof(m_slots));
+    }
+
+    ~SessionKeyRing() {
+        memset(m_slots, 0, sizeof(m_slots));
+    }
+
+    // 使用握手得到的初始密钥，从序号0开始生效
+    void Reset(const char* key) {
+        CDesOperate::ExpandKey(key, 8, m_slots[0]);
+        memcpy(&m_slots[1], &m_slots[0], sizeof(DesKeySchedule));
+        m_active.store(0, std::memory_order_release);
+        m_pending = false;
+        m_activate_seq = 0;
+        m_switch_seq = 0;
+        m_generation = 0;
+    }
+
+    // 预先展开新密钥，序号不小于activate_seq的帧使用新密钥
+    void Prepare(const char* key, uint32_t activate_seq) {
+        int next = 1 - m_active.load(std::memory_order_acquire);
+        CDesOperate::ExpandKey(key, 8, m_slots[next]);
+        m_activate_seq = activate_seq;
+        m_pending = true;
+    }
+
+    // 取得序号seq应使用的密钥编排，第一次遇到生效序号时完成切换
+    const DesKeySchedule& ForSeq(uint32_t seq) {
+        int active = m_active.load(std::memory_order_acquire);
+        if (m_pending && SeqAtLeast(seq, m_activate_seq)) {
+            active = 1 - active;
+            m_active.store(active, std::memory_order_release);
+            m_switch_seq = m_activate_seq;
+            m_pending = false;
+            m_generation++;
+        }
+
+        // 上次切换之前发出、仍在途中的帧使用旧密钥
+        if (m_generation > 0 && !SeqAtLeast(seq, m_switch_seq)) {
+            return m_slots[1 - active];
+        }
+        return m_slots[active];
+    }
+
+    // 是否有尚未生效的新密钥
+    bool Pending() const { return m_pending; }
+
+    // 已完成的换钥次数
+    uint32_t Generation() const { return m_generation; }
+
+private:
+    // 带回绕的序号比较：a >= b
+    static bool SeqAtLeast(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) >= 0;
+    }
+
+    DesKeySchedule m_slots[2];     // 双缓冲密钥编排
+    std::atomic<int> m_active;     // 当前生效的槽位
+    bool m_pending;                // 空闲槽位中是否有待生效的新密钥
+    uint32_t m_activate_seq;       // 新密钥的生效序号
+    uint32_t m_switch_seq;         // 上一次切换发生的序号
+    uint32_t m_generation;         // 已完成的换钥次数
+};
+
+#endif // SESSION_KEYS_H
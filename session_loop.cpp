@@ -0,0 +1,695 @@
+#include "session_loop.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <random>
+
+#define SESSION_READ_BUFFER_SIZE (2 * (int)(sizeof(FrameHeader) + FRAME_MAX_PAYLOAD))   // 共用读缓冲大小，暂存的半帧之后至少还能读入一整帧
+
+static MetricGauge& ActiveSessions() {
+    static MetricGauge& gauge = MetricsRegistry::GetInstance().Gauge(
+        "chat_active_sessions", "进行中的聊天会话数");
+    return gauge;
+}
+
+static MetricGauge& ThrottledSessions() {
+    static MetricGauge& gauge = MetricsRegistry::GetInstance().Gauge(
+        "chat_sessions_throttled", "当前因限速暂停读取的会话数");
+    return gauge;
+}
+
+CSessionLoop::CSessionLoop()
+    : m_epoll_fd(-1), m_wake_fd(-1), m_sessions(0),
+      m_idle_timeout_ms(SESSION_IDLE_TIMEOUT_MS), m_heartbeat_ms(SESSION_HEARTBEAT_MS),
+      m_rate_msgs(SESSION_RATE_MSGS), m_rate_bytes(SESSION_RATE_BYTES),
+      m_rekey_bytes(REKEY_BYTES), m_rekey_seconds(REKEY_SECONDS),
+      m_read_buf(SESSION_READ_BUFFER_SIZE), m_plain_buf(BUFFER_SIZE + 1), m_frame_buf(FRAME_BUFFER_SIZE),
+      m_timers(SESSION_TICK_MS), m_resume_timers(SESSION_TICK_MS), m_heartbeat_seq(0) {
+}
+
+CSessionLoop::~CSessionLoop() {
+    // 事件循环线程与服务器同生命周期，进程退出时不等待它结束
+    if (m_thread.joinable()) {
+        m_thread.detach();
+    }
+}
+
+// 设置空闲超时与心跳间隔
+void CSessionLoop::SetIdlePolicy(int idle_timeout_ms, int heartbeat_ms) {
+    m_idle_timeout_ms = idle_timeout_ms > 0 ? idle_timeout_ms : 0;
+    m_heartbeat_ms = heartbeat_ms > 0 ? heartbeat_ms : 0;
+}
+
+// 设置每个连接的速率上限
+void CSessionLoop::SetRateLimit(int msgs_per_sec, int bytes_per_sec) {
+    m_rate_msgs = msgs_per_sec > 0 ? msgs_per_sec : 0;
+    m_rate_bytes = bytes_per_sec > 0 ? bytes_per_sec : 0;
+}
+
+// 设置换钥阈值
+void CSessionLoop::SetRekeyPolicy(uint64_t bytes, int seconds) {
+    m_rekey_bytes = bytes;
+    m_rekey_seconds = seconds > 0 ? seconds : 0;
+}
+
+// 创建epoll与唤醒描述符，启动事件循环线程
+bool CSessionLoop::Start() {
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_wake_fd < 0) {
+        perror("epoll");
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = m_wake_fd;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    m_timers.Start(TraceNowNs() / 1000000);
+    m_resume_timers.Start(TraceNowNs() / 1000000);
+    m_thread = std::thread(&CSessionLoop::Run, this);
+    return true;
+}
+
+// 握手线程调用：把连接放入待接管队列并唤醒事件循环
+void CSessionLoop::Adopt(int fd, const struct sockaddr_in& peer, const char* key, uint32_t send_seq,
+                         uint32_t capture_id, const std::string& early) {
+    PendingSession pending;
+    pending.fd = fd;
+    pending.peer = peer;
+    memcpy(pending.key, key, sizeof(pending.key));
+    pending.send_seq = send_seq;
+    pending.capture_id = capture_id;
+    pending.early = early;
+    m_sessions++;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(std::move(pending));
+    }
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("eventfd write");
+    }
+}
+
+void CSessionLoop::Run() {
+    struct epoll_event events[SESSION_LOOP_MAX_EVENTS];
+    while (1) {
+        // 有定时器时每个节拍醒来一次推进时间轮
+        int timeout = m_timers.Count() + m_resume_timers.Count() > 0 ? (int)m_timers.TickMs() : -1;
+        int n = epoll_wait(m_epoll_fd, events, SESSION_LOOP_MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno != EINTR) {
+                perror("epoll_wait");
+                return;
+            }
+            n = 0;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == m_wake_fd) {
+                uint64_t count;
+                while (read(m_wake_fd, &count, sizeof(count)) > 0) {
+                }
+                AdoptPending();
+                continue;
+            }
+
+            // 同一批事件中较早的事件可能已关闭该连接
+            ConnHot* hot = m_table.Find(fd);
+            if (hot == NULL) {
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                HandleWritable(*hot);
+                if (hot->state == CONN_FREE) {
+                    continue;
+                }
+            }
+            if (!(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                continue;
+            }
+            if (!(hot->flags & CONN_FLAG_THROTTLED)) {
+                HandleReadable(*hot);
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                Close(*hot);        // 限速期间不读取，但连接已失效
+            }
+        }
+        uint64_t now_ms = TraceNowNs() / 1000000;
+        m_resume_timers.Advance(now_ms, [this](int fd) { OnResume(fd); });
+        m_timers.Advance(now_ms, [this](int fd) { OnTimer(fd); });
+    }
+}
+
+// 把移交的连接加入槽位表与epoll，并转发随握手到达的消息
+void CSessionLoop::AdoptPending() {
+    static MetricGauge& table_bytes = MetricsRegistry::GetInstance().Gauge(
+        "chat_connection_table_bytes", "连接槽位表占用的内存（字节）");
+
+    std::vector<PendingSession> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending.swap(m_pending);
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        PendingSession& session = pending[i];
+        int flags = fcntl(session.fd, F_GETFL, 0);
+        fcntl(session.fd, F_SETFL, flags | O_NONBLOCK);
+
+        ConnHot& hot = m_table.Insert(session.fd);
+        ConnCold& cold = m_table.Cold(session.fd);
+        hot.send_seq = session.send_seq;
+        hot.crypto = new SessionCrypto;
+        hot.crypto->send_keys.Reset(session.key);
+        hot.crypto->recv_keys.Reset(session.key);
+        memset(session.key, 0, sizeof(session.key));
+        hot.last_active_ns = TraceNowNs();
+        cold.peer = session.peer;
+        cold.capture_id = session.capture_id;
+        cold.established_ns = hot.last_active_ns;
+        cold.last_rekey = time(nullptr);
+        cold.bucket_ns = hot.last_active_ns;
+        cold.msg_tokens = std::max(m_rate_msgs, 1);
+        cold.byte_tokens = std::max(m_rate_bytes, (int)(sizeof(FrameHeader) + FRAME_MAX_PAYLOAD));
+        ArmTimer(hot);
+
+        ActiveSessions().Add(1);
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = session.fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, session.fd, &event) < 0) {
+            LOG_ERROR("加入epoll失败: " + std::string(strerror(errno)));
+            Close(hot);
+            continue;
+        }
+
+        if (!session.early.empty()) {
+            Broadcast(session.fd, session.early.data(), session.early.size());
+        }
+    }
+    table_bytes.Set(m_table.TableBytes());
+}
+
+// 差额轮询：每次可读事件为连接增加一份额度，最多读取累积的额度。读不完的数据留在内核缓冲中，
+// 水平触发的epoll在下一轮再次报告该连接，活跃的连接按轮次交替得到服务；内核缓冲读空时清零额度。
+// 额度只扣除本轮新读入的字节。暂存的半帧即使超出额度也一次读完，否则大帧可能永远凑不齐
+void CSessionLoop::HandleReadable(ConnHot& hot) {
+    char* buffer = m_read_buf.data();
+    int have = TakePartial(hot, buffer);
+    hot.deficit += SESSION_DRR_QUANTUM;
+    int want = std::max(hot.deficit, PartialFrameRemaining(buffer, have));
+    want = std::min((int)m_read_buf.size() - have, want);
+    assert(have + want <= (int)m_read_buf.size());
+    if (want <= 0) {
+        StashPartial(hot, buffer, have);
+        return;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(hot.fd, buffer + have, want, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        hot.deficit = 0;
+        StashPartial(hot, buffer, have);
+        return;
+    }
+    if (n <= 0) {
+        if (n < 0) {
+            LOG_INFO("接收数据失败: " + std::string(strerror(errno)));
+        }
+        Close(hot);
+        return;
+    }
+    hot.last_active_ns = TraceNowNs();
+    m_table.Cold(hot.fd).bytes_in += n;
+
+    if (ProcessFrames(hot, buffer, have + n) < 0) {
+        return;
+    }
+    hot.deficit = n < want ? 0 : std::max(0, hot.deficit - (int)n);
+}
+
+// 暂存数据中未收完的那一帧还差多少字节（帧头不完整时只算到帧头），没有暂存数据时返回0
+int CSessionLoop::PartialFrameRemaining(const char* buffer, int have) {
+    if (have == 0) {
+        return 0;
+    }
+    if (have < (int)sizeof(FrameHeader)) {
+        return sizeof(FrameHeader) - have;
+    }
+    FrameHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    uint32_t length = ntohl(header.length);
+    if (length > FRAME_MAX_PAYLOAD) {
+        return 0;       // 非法长度由ProcessFrames断开连接
+    }
+    return std::max(0, (int)(sizeof(header) + length) - have);
+}
+
+// 逐帧处理缓冲中的数据：先按帧头检查令牌桶，再解密处理。剩余的半帧（或限速时尚未处理的帧）暂存起来。
+// 返回已处理的字节数，连接被关闭时返回-1
+int CSessionLoop::ProcessFrames(ConnHot& hot, char* buffer, int len) {
+    uint64_t now = TraceNowNs();
+    int pos = 0;
+    while (len - pos >= (int)sizeof(FrameHeader)) {
+        FrameHeader header;
+        memcpy(&header, buffer + pos, sizeof(header));
+        header.length = ntohl(header.length);
+        header.seq = ntohl(header.seq);
+        header.checksum = ntohl(header.checksum);
+
+        // 长度非法时无法再对齐后续帧，只能断开；只有批量数据块可以超过单条消息的长度
+        uint32_t max_len = header.type == FRAME_BULK ? FRAME_MAX_PAYLOAD : BUFFER_SIZE;
+        if (header.length == 0 || header.length > max_len) {
+            LOG_ERROR("帧长度非法: " + std::to_string(header.length) + " 字节");
+            Close(hot);
+            return -1;
+        }
+        int frame_len = sizeof(header) + header.length;
+        if (len - pos < frame_len) {
+            break;
+        }
+        uint64_t wait_ms;
+        if (!Admit(hot, frame_len, now, wait_ms)) {
+            StashPartial(hot, buffer + pos, len - pos);
+            Throttle(hot, wait_ms);
+            return pos;
+        }
+        if (!ProcessFrame(hot, header, buffer + pos + sizeof(header))) {
+            Close(hot);
+            return -1;
+        }
+        pos += frame_len;
+    }
+    StashPartial(hot, buffer + pos, len - pos);
+    return pos;
+}
+
+// 令牌桶：按经过的时间补充令牌（最多一秒的额度），令牌足够时扣除一帧，否则返回需要等待的毫秒数
+bool CSessionLoop::Admit(ConnHot& hot, int frame_len, uint64_t now, uint64_t& wait_ms) {
+    if (m_rate_msgs == 0 && m_rate_bytes == 0) {
+        return true;
+    }
+    ConnCold& cold = m_table.Cold(hot.fd);
+    double elapsed = now > cold.bucket_ns ? (now - cold.bucket_ns) / 1e9 : 0;
+    cold.bucket_ns = std::max(now, cold.bucket_ns);
+
+    double wait = 0;
+    if (m_rate_msgs > 0) {
+        cold.msg_tokens = std::min((double)std::max(m_rate_msgs, 1), cold.msg_tokens + elapsed * m_rate_msgs);
+        if (cold.msg_tokens < 1) {
+            wait = (1 - cold.msg_tokens) / m_rate_msgs;
+        }
+    }
+    if (m_rate_bytes > 0) {
+        double burst = std::max(m_rate_bytes, (int)(sizeof(FrameHeader) + FRAME_MAX_PAYLOAD));
+        cold.byte_tokens = std::min(burst, cold.byte_tokens + elapsed * m_rate_bytes);
+        if (cold.byte_tokens < frame_len) {
+            wait = std::max(wait, (frame_len - (double)cold.byte_tokens) / m_rate_bytes);
+        }
+    }
+    if (wait > 0) {
+        wait_ms = (uint64_t)(wait * 1000) + 1;
+        return false;
+    }
+    if (m_rate_msgs > 0) {
+        cold.msg_tokens -= 1;
+    }
+    if (m_rate_bytes > 0) {
+        cold.byte_tokens -= frame_len;
+    }
+    return true;
+}
+
+// 暂停读取超过速率的连接
+void CSessionLoop::Throttle(ConnHot& hot, uint64_t wait_ms) {
+    static MetricCounter& throttled = MetricsRegistry::GetInstance().Counter(
+        "chat_sessions_throttled_total", "超过速率限制而暂停读取的次数");
+
+    throttled.Inc();
+    ThrottledSessions().Add(1);
+    hot.flags |= CONN_FLAG_THROTTLED;
+    UpdateEvents(hot);
+    m_resume_timers.Schedule(hot.fd, wait_ms);
+}
+
+// 令牌补足：先处理暂存的帧（可能再次被限速），再恢复读取
+void CSessionLoop::OnResume(int fd) {
+    ConnHot* hot = m_table.Find(fd);
+    if (hot == NULL || !(hot->flags & CONN_FLAG_THROTTLED)) {
+        return;
+    }
+    hot->flags &= ~CONN_FLAG_THROTTLED;
+    ThrottledSessions().Add(-1);
+
+    char* buffer = m_read_buf.data();
+    int have = TakePartial(*hot, buffer);
+    if (ProcessFrames(*hot, buffer, have) < 0) {
+        return;
+    }
+    if (!(hot->flags & CONN_FLAG_THROTTLED)) {
+        UpdateEvents(*hot);
+    }
+}
+
+// 限速期间不关注可读事件，数据留在内核缓冲中；有排队的发送数据时关注可写事件
+void CSessionLoop::UpdateEvents(ConnHot& hot) {
+    struct epoll_event event;
+    event.events = 0;
+    if (!(hot.flags & CONN_FLAG_THROTTLED)) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (hot.tx_buf != NULL) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = hot.fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, hot.fd, &event);
+}
+
+// 校验解密一帧并按类型处理，需要断开连接时返回false
+bool CSessionLoop::ProcessFrame(ConnHot& hot, const FrameHeader& header, const char* payload) {
+    // 事件循环只转发聊天消息，批量数据块没有接收方：计入限速、统计与流量捕获后丢弃，不解密，
+    // 捕获中只有帧类型与线路长度（明文长度记为0）
+    if (header.type == FRAME_BULK) {
+        static MetricCounter& bulk_dropped = MetricsRegistry::GetInstance().Counter(
+            "chat_bulk_bytes_dropped_total", "多会话服务器丢弃的批量数据块字节数");
+        bulk_dropped.Add(header.length);
+        ConnCold& cold = m_table.Cold(hot.fd);
+        cold.frames_in++;
+        CaptureWriter::GetInstance().RecordFrame(cold.capture_id, header.type, 0, sizeof(header) + header.length);
+        return true;
+    }
+    if (header.type != FRAME_CHAT && header.type != FRAME_REKEY &&
+        header.type != FRAME_PING && header.type != FRAME_ECHO) {
+        LOG_WARNING("忽略未知类型的帧: " + std::to_string(header.type));
+        return true;
+    }
+
+    char* plain = m_plain_buf.data();
+    int plain_len = CTcpSocket::OpenSealedFrame(m_des, hot.crypto->recv_keys, header, payload,
+                                                plain, m_plain_buf.size());
+    if (plain_len < 0) {
+        return true;
+    }
+    ConnCold& cold = m_table.Cold(hot.fd);
+    cold.frames_in++;
+    CaptureWriter::GetInstance().RecordFrame(cold.capture_id, header.type, plain_len,
+                                             sizeof(header) + header.length);
+
+    if (header.type == FRAME_REKEY) {
+        if (plain_len >= (int)sizeof(RekeyPayload)) {
+            RekeyPayload rekey;
+            memcpy(&rekey, plain, sizeof(rekey));
+            hot.crypto->recv_keys.Prepare(rekey.key, ntohl(rekey.activate_seq));
+            memset(&rekey, 0, sizeof(rekey));
+        }
+        return true;
+    }
+    if (header.type == FRAME_PING) {
+        // 与CTcpSocket::HandlePing相同：填写解密完成的时间后原样发回
+        if (plain_len < (int)sizeof(PingPayload)) {
+            return true;
+        }
+        PutBigEndian64(((PingPayload*)plain)->peer_recv_real, RealtimeNs());
+        return SendFrame(hot, FRAME_ECHO, plain, plain_len);
+    }
+    if (header.type == FRAME_ECHO) {
+        // 心跳的应答：用本端单调时钟计算往返时间
+        if (plain_len >= (int)sizeof(PingPayload)) {
+            uint64_t sent_mono = GetBigEndian64(((PingPayload*)plain)->sent_mono);
+            uint64_t now = TraceNowNs();
+            if (sent_mono <= now) {
+                PingRttHistogram().Record(now - sent_mono);
+            }
+        }
+        return true;
+    }
+
+    Broadcast(hot.fd, plain, strlen(plain));
+    return true;
+}
+
+// 把消息转发给其他所有会话，消息前加上发送方地址
+void CSessionLoop::Broadcast(int from, const char* text, int len) {
+    static MetricCounter& forwarded = MetricsRegistry::GetInstance().Counter(
+        "chat_messages_forwarded_total", "转发给其他会话的消息数");
+
+    char message[BUFFER_SIZE];
+    struct sockaddr_in addr = m_table.Cold(from).peer;
+    int prefix = snprintf(message, BUFFER_SIZE, "[%s:%d] ", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    if (len > BUFFER_SIZE - prefix - 1) {
+        len = BUFFER_SIZE - prefix - 1;
+    }
+    memcpy(message + prefix, text, len);
+
+    for (int fd = 0; fd < m_table.Capacity(); fd++) {
+        ConnHot& hot = m_table.At(fd);
+        if (hot.state != CONN_ESTABLISHED || fd == from) {
+            continue;
+        }
+        if (SendFrame(hot, FRAME_CHAT, message, prefix + len)) {
+            forwarded.Inc();
+        } else {
+            Close(hot);
+        }
+    }
+}
+
+// 加密并发送一帧；聊天消息先按CTcpSocket::SendChatMessage相同的阈值检查是否需要换钥
+bool CSessionLoop::SendFrame(ConnHot& hot, uint8_t type, const char* data, int data_len) {
+    ConnCold& cold = m_table.Cold(hot.fd);
+    if (type == FRAME_CHAT) {
+        bool bytes_due = m_rekey_bytes > 0 && cold.bytes_since_rekey >= m_rekey_bytes;
+        bool time_due = m_rekey_seconds > 0 && time(nullptr) - cold.last_rekey >= m_rekey_seconds;
+        if ((bytes_due || time_due) && !SendRekey(hot)) {
+            return false;
+        }
+    }
+
+    int frame_len = CTcpSocket::SealFrame(m_des, hot.crypto->send_keys, hot.send_seq, type, data, data_len,
+                                          m_frame_buf.data(), m_frame_buf.size());
+    if (frame_len < 0) {
+        LOG_ERROR("消息加密失败");
+        return false;
+    }
+    hot.send_seq++;
+    cold.frames_out++;
+    cold.last_sent_ns = TraceNowNs();
+    if (type == FRAME_CHAT) {
+        cold.bytes_since_rekey += frame_len;
+    }
+    return QueueSend(hot, m_frame_buf.data(), frame_len);
+}
+
+// 发送方向换钥，与CTcpSocket::SendRekey相同：新密钥自下一帧起生效
+bool CSessionLoop::SendRekey(ConnHot& hot) {
+    char new_key[8];
+    std::random_device rd;
+    for (int i = 0; i < 8; i += 4) {
+        uint32_t r = rd();
+        memcpy(new_key + i, &r, 4);
+    }
+
+    RekeyPayload rekey;
+    memset(&rekey, 0, sizeof(rekey));
+    memcpy(rekey.key, new_key, 8);
+    uint32_t activate_seq = hot.send_seq + 1;
+    rekey.activate_seq = htonl(activate_seq);
+    hot.crypto->send_keys.Prepare(new_key, activate_seq);
+    memset(new_key, 0, sizeof(new_key));
+
+    ConnCold& cold = m_table.Cold(hot.fd);
+    bool ok = SendFrame(hot, FRAME_REKEY, (char*)&rekey, sizeof(rekey));
+    memset(&rekey, 0, sizeof(rekey));
+    cold.bytes_since_rekey = 0;
+    cold.last_rekey = time(nullptr);
+    return ok;
+}
+
+// 先直接写入套接字，写不完的部分排队到tx_buf，等待可写事件
+bool CSessionLoop::QueueSend(ConnHot& hot, const char* data, int len) {
+    static MetricCounter& slow = MetricsRegistry::GetInstance().Counter(
+        "chat_sessions_dropped_slow_total", "待发送数据超过上限而被断开的会话数");
+
+    m_table.Cold(hot.fd).bytes_out += len;
+    if (hot.tx_buf == NULL) {
+        ssize_t n = send(hot.fd, data, len, MSG_NOSIGNAL);
+        if (n == len) {
+            return true;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return false;
+            }
+            n = 0;
+        }
+        data += n;
+        len -= n;
+    }
+
+    uint32_t pending = hot.tx_len - hot.tx_off;
+    if (pending + len > SESSION_TX_LIMIT) {
+        slow.Inc();
+        LOG_WARNING("会话待发送数据超过上限，断开连接");
+        return false;
+    }
+    if (hot.tx_buf == NULL || hot.tx_len + len > hot.tx_cap) {
+        // 借用更大的缓冲区并把未发送的数据移到开头
+        size_t capacity;
+        size_t need = std::max((size_t)(pending + len), (size_t)hot.tx_cap * 2);
+        char* buffer = (char*)BufferPool::GetInstance().Allocate(need, &capacity);
+        bool first = hot.tx_buf == NULL;
+        if (!first) {
+            memcpy(buffer, hot.tx_buf + hot.tx_off, pending);
+            BufferPool::GetInstance().Release(hot.tx_buf);
+        }
+        hot.tx_buf = buffer;
+        hot.tx_cap = capacity;
+        hot.tx_off = 0;
+        hot.tx_len = pending;
+
+        // 开始排队时关注可写事件
+        if (first) {
+            UpdateEvents(hot);
+        }
+    }
+    memcpy(hot.tx_buf + hot.tx_len, data, len);
+    hot.tx_len += len;
+    return true;
+}
+
+// 套接字可写：发送排队的数据，发完后归还缓冲区并不再关注可写事件
+void CSessionLoop::HandleWritable(ConnHot& hot) {
+    while (hot.tx_buf != NULL && hot.tx_off < hot.tx_len) {
+        ssize_t n = send(hot.fd, hot.tx_buf + hot.tx_off, hot.tx_len - hot.tx_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            Close(hot);
+            return;
+        }
+        hot.tx_off += n;
+    }
+
+    BufferPool::GetInstance().Release(hot.tx_buf);
+    hot.tx_buf = NULL;
+    hot.tx_len = 0;
+    hot.tx_off = 0;
+    hot.tx_cap = 0;
+    UpdateEvents(hot);
+}
+
+// 暂存未处理的数据，len为0时不借用缓冲区
+void CSessionLoop::StashPartial(ConnHot& hot, const char* data, int len) {
+    if (len <= 0) {
+        return;
+    }
+    hot.rx_buf = (char*)BufferPool::GetInstance().Allocate(len);
+    hot.rx_len = len;
+    memcpy(hot.rx_buf, data, len);
+}
+
+// 把暂存的数据复制到读缓冲开头并归还缓冲区
+int CSessionLoop::TakePartial(ConnHot& hot, char* buffer) {
+    if (hot.rx_buf == NULL) {
+        return 0;
+    }
+    int len = hot.rx_len;
+    memcpy(buffer, hot.rx_buf, len);
+    BufferPool::GetInstance().Release(hot.rx_buf);
+    hot.rx_buf = NULL;
+    hot.rx_len = 0;
+    return len;
+}
+
+// 下一次检查的时间：空闲超时到期，或收发两个方向都沉默满一个心跳间隔
+void CSessionLoop::ArmTimer(ConnHot& hot) {
+    if (m_idle_timeout_ms == 0 && m_heartbeat_ms == 0) {
+        return;
+    }
+    uint64_t due = UINT64_MAX;
+    if (m_idle_timeout_ms > 0) {
+        due = hot.last_active_ns + (uint64_t)m_idle_timeout_ms * 1000000;
+    }
+    if (m_heartbeat_ms > 0) {
+        uint64_t last = std::max(hot.last_active_ns, m_table.Cold(hot.fd).last_sent_ns);
+        due = std::min(due, last + (uint64_t)m_heartbeat_ms * 1000000);
+    }
+    uint64_t now = TraceNowNs();
+    m_timers.Schedule(hot.fd, due > now ? (due - now) / 1000000 : 0);
+}
+
+// 定时器到期：节拍的粒度可能使检查略早于到期时间，这时只重新安排
+void CSessionLoop::OnTimer(int fd) {
+    static MetricCounter& idle_closed = MetricsRegistry::GetInstance().Counter(
+        "chat_sessions_idle_timeout_total", "因空闲超时被断开的会话数");
+
+    ConnHot* hot = m_table.Find(fd);
+    if (hot == NULL) {
+        return;
+    }
+    uint64_t now = TraceNowNs();
+    uint64_t idle = now - hot->last_active_ns;
+    if (m_idle_timeout_ms > 0 && idle >= (uint64_t)m_idle_timeout_ms * 1000000) {
+        idle_closed.Inc();
+        LOG_INFO("会话空闲超时，断开连接");
+        Close(*hot);
+        return;
+    }
+    // 只有收发两个方向都沉默时才发送心跳：正在向对端转发消息的连接不需要心跳
+    uint64_t heartbeat = (uint64_t)m_heartbeat_ms * 1000000;
+    if (m_heartbeat_ms > 0 && idle >= heartbeat && now - m_table.Cold(fd).last_sent_ns >= heartbeat) {
+        if (!SendHeartbeat(*hot)) {
+            Close(*hot);
+            return;
+        }
+    }
+    ArmTimer(*hot);
+}
+
+// 心跳是加密的探测帧，客户端在接收循环中回应，应答使会话重新活跃
+bool CSessionLoop::SendHeartbeat(ConnHot& hot) {
+    static MetricCounter& heartbeats = MetricsRegistry::GetInstance().Counter(
+        "chat_heartbeats_sent_total", "向空闲会话发送的心跳数");
+
+    PingPayload ping;
+    memset(&ping, 0, sizeof(ping));
+    ping.probe_seq = htonl(m_heartbeat_seq++);
+    uint64_t now = TraceNowNs();
+    PutBigEndian64(ping.sent_mono, now);
+    PutBigEndian64(ping.sent_real, RealtimeNs());
+    heartbeats.Inc();
+    return SendFrame(hot, FRAME_PING, (char*)&ping, sizeof(ping));
+}
+
+// 关闭连接：归还缓冲区与密钥编排，释放槽位
+void CSessionLoop::Close(ConnHot& hot) {
+    int fd = hot.fd;
+    m_timers.Cancel(fd);
+    if (hot.flags & CONN_FLAG_THROTTLED) {
+        m_resume_timers.Cancel(fd);
+        ThrottledSessions().Add(-1);
+    }
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    BufferPool::GetInstance().Release(hot.rx_buf);
+    BufferPool::GetInstance().Release(hot.tx_buf);
+    hot.rx_buf = NULL;
+    hot.tx_buf = NULL;
+    delete hot.crypto;
+    hot.crypto = NULL;
+    CaptureWriter::GetInstance().CloseConnection(m_table.Cold(fd).capture_id);
+    m_table.Remove(fd);
+    m_sessions--;
+    ActiveSessions().Add(-1);
+}
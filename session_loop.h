@@ -0,0 +1,109 @@
+#ifndef SESSION_LOOP_H
+#define SESSION_LOOP_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tcp_socket.h"
+#include "connection_table.h"
+#include "timer_wheel.h"
+
+#define SESSION_LOOP_MAX_EVENTS 256          // 每次epoll_wait最多取回的事件数
+#define SESSION_TX_LIMIT (4 * 1024 * 1024)   // 单个连接排队待发送数据的上限，超过视为消费过慢并断开
+#define SESSION_TICK_MS 100                  // 会话定时器的节拍
+#define SESSION_IDLE_TIMEOUT_MS 90000        // 默认空闲超时：这么长时间没有收到任何帧即断开
+#define SESSION_HEARTBEAT_MS 30000           // 默认心跳间隔：收发两个方向都这么长时间没有帧时发送心跳
+#define SESSION_DRR_QUANTUM (16 * 1024)      // 差额轮询的份额：每轮事件循环每个连接新增的可读取字节数
+#define SESSION_RATE_MSGS 1000               // 默认每个连接每秒最多处理的帧数
+#define SESSION_RATE_BYTES (1024 * 1024)     // 默认每个连接每秒最多处理的字节数
+
+// 已建立会话的事件循环
+// 握手仍在各自的线程上完成，完成后连接交给事件循环：描述符设为非阻塞并加入epoll，
+// 会话状态压缩为槽位表中的一条热/冷记录与一份密钥编排，原来的CTcpSocket与握手线程随即释放。
+// 所有已建立会话的收发、解密、探测应答与消息转发都在这一个线程上完成，槽位表不需要加锁。
+// 每个会话在时间轮中有一个定时器：收发两个方向都沉默达到心跳间隔时发送加密的探测帧作为心跳，
+// 客户端的应答刷新活动时间；对端沉默达到空闲超时则断开。收发帧时不改动定时器，到期时再按最近收发时间重新安排。
+// 每个连接有帧数与字节数两个令牌桶（容量为一秒的额度），在解密之前按帧头扣除；令牌不足时暂停读取该连接，
+// 未处理的帧暂存起来，等令牌补足后继续，数据不会丢失，积压的数据由TCP流量控制挡在客户端。
+// 各连接按差额轮询获得服务：每轮最多读取累积的份额，读不完的数据留在内核中等待下一轮。
+class CSessionLoop {
+public:
+    CSessionLoop();
+    ~CSessionLoop();
+
+    bool Start();          // 创建epoll与唤醒描述符，启动事件循环线程
+
+    // 设置空闲超时与心跳间隔（毫秒），0表示关闭；在Start之前调用
+    void SetIdlePolicy(int idle_timeout_ms, int heartbeat_ms);
+    // 设置每个连接每秒的帧数与字节数上限，0表示不限；在Start之前调用
+    void SetRateLimit(int msgs_per_sec, int bytes_per_sec);
+    // 设置发送方向的换钥阈值（字节、秒），0表示不按该条件换钥；在Start之前调用
+    void SetRekeyPolicy(uint64_t bytes, int seconds);
+
+    // 从握手线程移交一个已完成握手的连接；early为随握手到达、需要转发的第一条消息
+    void Adopt(int fd, const struct sockaddr_in& peer, const char* key, uint32_t send_seq,
+               uint32_t capture_id, const std::string& early);
+
+    int SessionCount() const { return m_sessions.load(std::memory_order_relaxed); }
+
+private:
+    // 等待事件循环接管的连接
+    struct PendingSession {
+        int fd;
+        struct sockaddr_in peer;
+        char key[8];
+        uint32_t send_seq;
+        uint32_t capture_id;
+        std::string early;
+    };
+
+    void Run();
+    void AdoptPending();                                   // 把移交的连接加入槽位表与epoll
+    void HandleReadable(ConnHot& hot);                     // 按差额轮询读取并处理完整的帧
+    static int PartialFrameRemaining(const char* buffer, int have);  // 暂存的半帧还差的字节数
+    int ProcessFrames(ConnHot& hot, char* buffer, int len);  // 处理缓冲中的完整帧，返回处理的字节数
+    bool Admit(ConnHot& hot, int frame_len, uint64_t now, uint64_t& wait_ms);  // 从令牌桶扣除一帧
+    void Throttle(ConnHot& hot, uint64_t wait_ms);         // 暂停读取，wait_ms后恢复
+    void OnResume(int fd);                                 // 令牌补足：处理暂存的帧并恢复读取
+    void UpdateEvents(ConnHot& hot);                       // 按限速与发送排队状态设置关注的事件
+    bool ProcessFrame(ConnHot& hot, const FrameHeader& header, const char* payload);
+    void Broadcast(int from, const char* text, int len);   // 把聊天消息转发给其他会话
+    bool SendFrame(ConnHot& hot, uint8_t type, const char* data, int data_len);
+    bool SendRekey(ConnHot& hot);                          // 发送方向换钥
+    bool QueueSend(ConnHot& hot, const char* data, int len);
+    void HandleWritable(ConnHot& hot);                     // 发送排队的数据
+    void StashPartial(ConnHot& hot, const char* data, int len);  // 暂存未处理的数据
+    int TakePartial(ConnHot& hot, char* buffer);           // 取回暂存的数据，返回字节数
+    void ArmTimer(ConnHot& hot);                           // 按最近活动与心跳时间安排下一次检查
+    void OnTimer(int fd);                                  // 定时器到期：发送心跳或断开空闲连接
+    bool SendHeartbeat(ConnHot& hot);
+    void Close(ConnHot& hot);
+
+    int m_epoll_fd;
+    int m_wake_fd;                         // eventfd，有连接移交时唤醒事件循环
+    std::thread m_thread;
+    std::mutex m_mutex;                    // 保护m_pending
+    std::vector<PendingSession> m_pending;
+    std::atomic<int> m_sessions;           // 已建立的会话数（含等待接管的）
+    int m_idle_timeout_ms;
+    int m_heartbeat_ms;
+    int m_rate_msgs;
+    int m_rate_bytes;
+    uint64_t m_rekey_bytes;
+    int m_rekey_seconds;
+
+    // 以下只由事件循环线程访问
+    ConnectionTable m_table;
+    CDesOperate m_des;
+    std::vector<char> m_read_buf;          // 所有连接共用的读缓冲
+    std::vector<char> m_plain_buf;         // 解密结果
+    std::vector<char> m_frame_buf;         // 加密后的待发送帧
+    TimerWheel m_timers;                   // 以描述符为编号的会话定时器
+    TimerWheel m_resume_timers;            // 限速连接的恢复时间
+    uint32_t m_heartbeat_seq;              // 下一个心跳的探测序号
+};
+
+#endif // SESSION_LOOP_H
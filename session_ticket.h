@@ -0,0 +1,286 @@
+#ifndef SESSION_TICKET_H
+#define SESSION_TICKET_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "des.h"
+#include "protocol.h"
+
+#define TICKET_MAGIC 0x544B5431          // "TKT1"
+#define TICKET_CACHE_CAPACITY 1024       // 服务端票据缓存默认容量
+#define TICKET_LIFETIME 3600             // 票据默认有效期（秒）
+#define CLIENT_TICKET_FILE "chatroom_client.ticket"  // 客户端票据保存路径
+
+// 64位整数的网络字节序转换（大端）
+inline void PutBigEndian64(unsigned char* out, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+inline uint64_t GetBigEndian64(const unsigned char* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// 票据缓存统计信息
+struct TicketCacheStats {
+    uint64_t hits;        // 命中次数
+    uint64_t misses;      // 未命中次数（不存在、已淘汰或已过期）
+    uint64_t evictions;   // 因容量不足被淘汰的条目数
+    uint64_t expired;     // 因过期被清除的条目数
+    uint64_t replays;     // 出示已兑换过的票据的次数（重放）
+    size_t size;          // 当前条目数
+    size_t capacity;      // 最大容量
+
+    // 命中率（百分比）
+    double HitRate() const {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : 100.0 * hits / total;
+    }
+};
+
+// 服务端票据缓存：按票据ID索引，超过容量时淘汰最早签发的条目
+class TicketCache {
+public:
+    explicit TicketCache(size_t capacity = TICKET_CACHE_CAPACITY) : m_capacity(capacity) {
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_stats.capacity = capacity;
+    }
+
+    // 插入新票据，必要时淘汰最早签发的条目
+    void Insert(uint64_t id, const char* key, int64_t expiry) {
+        auto it = m_index.find(id);
+        if (it != m_index.end()) {
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+
+        while (m_capacity > 0 && m_lru.size() >= m_capacity) {
+            m_index.erase(m_lru.back().id);
+            m_lru.pop_back();
+            m_stats.evictions++;
+        }
+
+        Entry entry;
+        entry.id = id;
+        memcpy(entry.key, key, sizeof(entry.key));
+        entry.expiry = expiry;
+        m_lru.push_front(entry);
+        m_index[id] = m_lru.begin();
+    }
+
+    // 取出票据：命中后即从缓存中删除，每张票据只能使用一次；replayed返回票据是否已被兑换过
+    bool Take(uint64_t id, int64_t now, char* key, int64_t& expiry, bool& replayed) {
+        replayed = false;
+        auto it = m_index.find(id);
+        if (it == m_index.end()) {
+            replayed = m_used.count(id) > 0;
+            if (replayed) {
+                m_stats.replays++;
+            }
+            m_stats.misses++;
+            return false;
+        }
+
+        if (it->second->expiry <= now) {
+            m_lru.erase(it->second);
+            m_index.erase(it);
+            m_stats.expired++;
+            m_stats.misses++;
+            return false;
+        }
+
+        memcpy(key, it->second->key, sizeof(it->second->key));
+        expiry = it->second->expiry;
+        memset(it->second->key, 0, sizeof(it->second->key));
+        m_lru.erase(it->second);
+        m_index.erase(it);
+        m_stats.hits++;
+        
+        // 记住最近兑换的票据ID（最多与缓存容量相同），用于识别重放
+        m_used.insert(id);
+        m_used_order.push_back(id);
+        while (m_used_order.size() > m_capacity) {
+            m_used.erase(m_used_order.front());
+            m_used_order.pop_front();
+        }
+        return true;
+    }
+
+    TicketCacheStats GetStats() const {
+        TicketCacheStats stats = m_stats;
+        stats.size = m_lru.size();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        char key[8];
+        int64_t expiry;
+    };
+
+    size_t m_capacity;
+    std::list<Entry> m_lru;   // 表头为最近签发
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+    std::unordered_set<uint64_t> m_used;     // 最近兑换过的票据ID
+    std::deque<uint64_t> m_used_order;       // 按兑换先后排列，超出容量时删除最早的
+    TicketCacheStats m_stats;
+};
+
+// 由票据中的密钥与双方的随机数导出一次恢复的会话密钥：以票据密钥对两个随机数做DES CBC-MAC。
+// 服务端随机数未知时（客户端加密0-RTT消息）传入全零
+inline void DeriveResumptionKey(const char* ticket_key, const unsigned char* client_nonce,
+                                const unsigned char* server_nonce, char* session_key) {
+    CDesOperate des;
+    DesKeySchedule schedule;
+    CDesOperate::ExpandKey(ticket_key, 8, schedule);
+    char block[HELLO_NONCE_SIZE];
+    int block_len = sizeof(block);
+    des.Encry((const char*)client_nonce, HELLO_NONCE_SIZE, block, block_len, schedule);
+    for (int i = 0; i < HELLO_NONCE_SIZE; i++) {
+        block[i] ^= server_nonce[i];
+    }
+    int key_len = 8;
+    des.Encry(block, sizeof(block), session_key, key_len, schedule);
+    memset(block, 0, sizeof(block));
+}
+
+// 会话票据管理器（服务端）
+// 票据明文 = magic | 票据ID | 会话密钥 | 过期时间（各8字节），使用服务端私有的票据密钥DES加密。
+// 票据只有在缓存中仍存在时才会被接受，兑换后即从缓存中删除，因此每张票据只能恢复一次会话，
+// 恢复后的会话由票据中的密钥与双方随机数导出新密钥，并签发新的票据。缓存容量同时限制了可恢复会话的数量。
+// 所有操作加锁，多会话服务器的各个会话线程可以共用一个实例。
+class SessionTicketManager {
+public:
+    SessionTicketManager(size_t capacity = TICKET_CACHE_CAPACITY, int lifetime = TICKET_LIFETIME)
+        : m_cache(capacity), m_lifetime(lifetime) {
+        std::random_device rd;
+        std::mt19937_64 gen(rd());
+        uint64_t k = gen();
+        memcpy(m_ticket_key, &k, sizeof(m_ticket_key));
+        m_next_id = gen();
+    }
+
+    ~SessionTicketManager() {
+        memset(m_ticket_key, 0, sizeof(m_ticket_key));
+    }
+
+    // 为会话密钥签发票据，返回过期时间
+    int64_t Issue(const char* session_key, unsigned char* blob) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int64_t expiry = (int64_t)time(nullptr) + m_lifetime;
+        uint64_t id = m_next_id++;
+
+        unsigned char plain[TICKET_BLOB_SIZE];
+        memset(plain, 0, sizeof(plain));
+        PutBigEndian64(plain, TICKET_MAGIC);
+        PutBigEndian64(plain + 8, id);
+        memcpy(plain + 16, session_key, 8);
+        PutBigEndian64(plain + 24, (uint64_t)expiry);
+
+        int blob_len = TICKET_BLOB_SIZE;
+        m_des.Encry((const char*)plain, sizeof(plain), (char*)blob, blob_len, m_ticket_key, 8);
+        memset(plain, 0, sizeof(plain));
+
+        m_cache.Insert(id, session_key, expiry);
+        return expiry;
+    }
+
+    // 验证并作废票据，取出签发时的会话密钥；replayed返回票据是否已被兑换过（此时应丢弃随票据到达的0-RTT消息）
+    bool Redeem(const unsigned char* blob, char* session_key, bool& replayed) {
+        replayed = false;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        unsigned char plain[TICKET_BLOB_SIZE];
+        int plain_len = TICKET_BLOB_SIZE;
+        if (!m_des.Decry((const char*)blob, TICKET_BLOB_SIZE, (char*)plain, plain_len, m_ticket_key, 8)) {
+            return false;
+        }
+
+        bool ok = false;
+        if (GetBigEndian64(plain) == TICKET_MAGIC) {
+            uint64_t id = GetBigEndian64(plain + 8);
+            int64_t expiry = (int64_t)GetBigEndian64(plain + 24);
+            char cached_key[8];
+            int64_t cached_expiry = 0;
+            // 缓存是权威来源：票据内容必须与签发时记录的一致
+            if (m_cache.Take(id, (int64_t)time(nullptr), cached_key, cached_expiry, replayed) &&
+                cached_expiry == expiry && memcmp(cached_key, plain + 16, 8) == 0) {
+                memcpy(session_key, cached_key, 8);
+                ok = true;
+            }
+            memset(cached_key, 0, sizeof(cached_key));
+        }
+        memset(plain, 0, sizeof(plain));
+        return ok;
+    }
+
+    TicketCacheStats GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cache.GetStats();
+    }
+
+private:
+    char m_ticket_key[8];     // 票据加密密钥，仅服务端持有
+    uint64_t m_next_id;       // 下一个票据ID
+    CDesOperate m_des;
+    TicketCache m_cache;
+    int m_lifetime;
+    mutable std::mutex m_mutex;
+};
+
+// 客户端保存的票据
+struct ClientTicket {
+    uint32_t server_ip;                          // 签发票据的服务器地址（网络字节序）
+    uint16_t port;                               // 服务器端口（网络字节序）
+    int64_t expiry;                              // 过期时间
+    char key[8];                                 // 对应的会话密钥
+    unsigned char ticket[TICKET_BLOB_SIZE];      // 不透明票据
+};
+
+// 读取客户端票据，地址不匹配或已过期时返回false
+inline bool LoadClientTicket(const char* path, uint32_t server_ip, uint16_t port, ClientTicket& ticket) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fread(&ticket, sizeof(ticket), 1, fp) == 1;
+    fclose(fp);
+
+    return ok && ticket.server_ip == server_ip && ticket.port == port &&
+           ticket.expiry > (int64_t)time(nullptr);
+}
+
+// 保存客户端票据（仅当前用户可读写）
+inline bool SaveClientTicket(const char* path, const ClientTicket& ticket) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    FILE* fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        return false;
+    }
+    bool ok = fwrite(&ticket, sizeof(ticket), 1, fp) == 1;
+    fclose(fp);
+    return ok;
+}
+
+#endif // SESSION_TICKET_H
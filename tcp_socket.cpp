@@ -1,12 +1,165 @@
 #include "tcp_socket.h"
-#include <sstream>  // 添加对stringstream的支持
-#include <iomanip>  // 添加对setw, setfill等格式化输出的支持
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+// 实时时钟纳秒数，用于估算单程延迟
+uint64_t RealtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 用系统随机源填充握手随机数
+static void FillRandom(unsigned char* out, int len) {
+    std::random_device rd;
+    for (int i = 0; i < len; i += 4) {
+        uint32_t r = rd();
+        memcpy(out + i, &r, std::min(4, len - i));
+    }
+}
+
+// 探测帧往返与单程延迟直方图
+MetricHistogram& PingRttHistogram() {
+    static MetricHistogram& histogram = MetricsRegistry::GetInstance().Histogram(
+        "chat_ping_rtt_ns", "探测帧往返延迟（纳秒，含两端加解密）");
+    return histogram;
+}
+
+MetricHistogram& PingOneWayHistogram() {
+    static MetricHistogram& histogram = MetricsRegistry::GetInstance().Histogram(
+        "chat_ping_one_way_ns", "探测帧单程延迟（纳秒，依赖两端时钟同步）");
+    return histogram;
+}
+
+// 控制台输入读取器：由一个独立线程阻塞读取标准输入，聊天会话从队列中取行。
+// 连接断开时发送线程可以立即被唤醒退出，不必等用户再输入一行。
+class ConsoleInput {
+public:
+    // 读线程分离运行，实例在进程生命周期内不析构
+    static ConsoleInput& GetInstance() {
+        static ConsoleInput* instance = new ConsoleInput();
+        return *instance;
+    }
+
+    // 取一行输入（不含换行符）；标准输入结束或stop被置位时返回false。
+    // arrived_ns非空时返回该行读入的时间，用于追踪输入在队列中等待的时间
+    bool ReadLine(std::string& line, const std::atomic<bool>& stop, uint64_t* arrived_ns = NULL) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_started) {
+            m_started = true;
+            std::thread(&ConsoleInput::ReaderLoop, this).detach();
+        }
+        m_cond.wait(lock, [&]() { return stop || m_eof || !m_lines.empty(); });
+        if (stop || m_lines.empty()) {
+            return false;
+        }
+        line.swap(m_lines.front().text);
+        if (arrived_ns != NULL) {
+            *arrived_ns = m_lines.front().arrived_ns;
+        }
+        m_lines.pop_front();
+        return true;
+    }
+
+    // 唤醒等待输入的线程，使其重新检查stop标志
+    void Wake() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+
+private:
+    ConsoleInput() : m_started(false), m_eof(false) {}
+
+    void ReaderLoop() {
+        char input[BUFFER_SIZE];
+        while (fgets(input, BUFFER_SIZE, stdin) != NULL) {
+            int len = strlen(input);
+            if (len > 0 && input[len - 1] == '\n') {
+                len--;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            InputLine line;
+            line.text.assign(input, len);
+            line.arrived_ns = TraceNowNs();
+            m_lines.push_back(line);
+            m_cond.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_eof = true;
+        m_cond.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    struct InputLine {
+        std::string text;
+        uint64_t arrived_ns;           // 读入时间
+    };
+
+    std::deque<InputLine> m_lines;     // 尚未被取走的输入行
+    bool m_started;                    // 读线程是否已启动
+    bool m_eof;                        // 标准输入是否已结束
+};
+
+// 预先生成的RSA密钥对：完整握手取走一个，同时在加密线程池上补充一个。
+// 只有客户端问候表明需要完整握手时才取用，只连接不发送数据或凭票据恢复的连接不消耗RSA计算；
+// 池中最多RSA_KEY_POOL_SIZE个密钥对，连接风暴中密钥生成的速度受线程池限制
+class RsaKeyPool {
+public:
+    static RsaKeyPool& GetInstance() {
+        static RsaKeyPool instance;
+        return instance;
+    }
+
+    // 取一个密钥对，尚未生成完时返回的future在生成后就绪
+    std::future<RSA> Take() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_keys.size() < RSA_KEY_POOL_SIZE + 1) {
+            m_keys.push_back(CryptoWorkerPool::GetInstance().Submit([]() {
+                RSA rsa;
+                rsa.GenerateKeys();
+                return rsa;
+            }));
+        }
+        std::future<RSA> key = std::move(m_keys.front());
+        m_keys.pop_front();
+        return key;
+    }
+
+private:
+    RsaKeyPool() {}
+
+    std::mutex m_mutex;
+    std::deque<std::future<RSA> > m_keys;   // 已生成或正在生成的密钥对
+};
 
 // 构造函数
 CTcpSocket::CTcpSocket() {
     m_socket = -1;
     m_client_socket = -1;
     m_is_server = false;
+    m_fast_open = false;
+    m_io_timeout_ms = 0;
+    m_capture_id = 0;
+    m_early_len = -1;
+    m_early_wire_len = 0;
+    m_tickets = &m_own_tickets;
+    m_resumption = true;
+    m_quiet = false;
+    m_send_seq = 0;
+    m_send_key_version = 0;
+    m_probe_seq = 0;
+    m_probe_interval_ms = 0;
+    m_bulk_chunk = BULK_CHUNK_DEFAULT;
+    m_next_stream = 1;
+    m_recv_dir = FILE_RECV_DIR;
+    m_rekey_bytes = REKEY_BYTES;
+    m_rekey_seconds = REKEY_SECONDS;
+    m_bytes_since_rekey = 0;
+    m_last_rekey = 0;
     
     // 初始化地址结构
     memset(&m_server_addr, 0, sizeof(m_server_addr));
@@ -58,13 +211,19 @@ bool CTcpSocket::InitServer(int port) {
 }
 
 // 开始监听
-bool CTcpSocket::StartListen() {
+bool CTcpSocket::StartListen(int backlog) {
     if (m_socket < 0 || !m_is_server) {
         return false;
     }
     
+    // 允许客户端在SYN中携带数据（TCP Fast Open），内核不支持时忽略
+#ifdef TCP_FASTOPEN
+    int qlen = backlog;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen));
+#endif
+    
     // 开始监听连接请求
-    if (listen(m_socket, MAX_CONN) < 0) {
+    if (listen(m_socket, backlog) < 0) {
         perror("listen failed");
         return false;
     }
@@ -75,28 +234,49 @@ bool CTcpSocket::StartListen() {
 
 // 接受连接
 int CTcpSocket::AcceptConnection() {
-    if (m_socket < 0 || !m_is_server) {
-        return -1;
-    }
-    
-    // 接受客户端连接
-    socklen_t client_len = sizeof(m_client_addr);
-    m_client_socket = accept(m_socket, (struct sockaddr*)&m_client_addr, &client_len);
-    
+    m_client_socket = AcceptClient(m_client_addr);
     if (m_client_socket < 0) {
-        perror("accept failed");
         return -1;
     }
     
     // 打印客户端信息
-    printf("server: got connection from %s, port %d, socket %d\n",
-           inet_ntoa(m_client_addr.sin_addr),
-           ntohs(m_client_addr.sin_port),
-           m_client_socket);
+    if (!m_quiet) {
+        printf("server: got connection from %s, port %d, socket %d\n",
+               inet_ntoa(m_client_addr.sin_addr),
+               ntohs(m_client_addr.sin_port),
+               m_client_socket);
+    }
     
     return m_client_socket;
 }
 
+// 接受一个连接并返回描述符，不改变当前连接
+int CTcpSocket::AcceptClient(struct sockaddr_in& addr) {
+    if (m_socket < 0 || !m_is_server) {
+        return -1;
+    }
+    
+    socklen_t client_len = sizeof(addr);
+    int fd = accept(m_socket, (struct sockaddr*)&addr, &client_len);
+    if (fd < 0) {
+        perror("accept failed");
+        return -1;
+    }
+    static MetricCounter& accepted = MetricsRegistry::GetInstance().Counter(
+        "chat_connections_accepted_total", "服务端接受的连接数");
+    accepted.Inc();
+    return fd;
+}
+
+// 接管多会话服务器已接受的连接
+void CTcpSocket::AdoptClient(int fd, const struct sockaddr_in& addr, SessionTicketManager* tickets) {
+    CloseClientSocket();
+    m_client_socket = fd;
+    m_client_addr = addr;
+    m_is_server = true;
+    m_tickets = tickets != NULL ? tickets : &m_own_tickets;
+}
+
 // 启动服务端安全通信，包含RSA密钥交换
 bool CTcpSocket::StartSecureServer() {
     // 检查套接字状态
@@ -114,74 +294,229 @@ bool CTcpSocket::StartSecureServer() {
     LOG_INFO("开始RSA密钥交换和DES安全通信建立...");
     std::cout << "\n[服务端] 正在建立安全通信..." << std::endl;
     
-    // 生成RSA密钥对
-    m_rsa.GenerateKeys();
+    bool resumed = false;
+    if (!EstablishSecureServer(resumed)) {
+        std::cerr << "[服务端] 握手失败" << std::endl;
+        return false;
+    }
+    
+    if (resumed) {
+        std::cout << "[服务端] 会话已通过票据恢复，跳过RSA密钥交换" << std::endl;
+    } else {
+        std::cout << "[服务端] 准备进入安全聊天模式..." << std::endl;
+    }
+    
+    // 开始加密通信
+    return SecretChat(m_des_key, 8);
+}
+
+// 完成服务端握手并按完整/恢复分别记录耗时
+bool CTcpSocket::EstablishSecureServer(bool& resumed) {
+    static MetricHistogram& full_latency = MetricsRegistry::GetInstance().Histogram(
+        "chat_handshake_full_us", "完整RSA握手耗时（微秒）");
+    static MetricHistogram& resumed_latency = MetricsRegistry::GetInstance().Histogram(
+        "chat_handshake_resumed_us", "票据恢复握手耗时（微秒）");
+    static MetricCounter& failures = MetricsRegistry::GetInstance().Counter(
+        "chat_handshake_failures_total", "握手失败次数");
+    
+    TRACE_SPAN("handshake", "server-handshake");
+    MetricStopwatch timer;
+    resumed = false;
+    m_early_len = -1;
+    if (!ServerHandshake(resumed)) {
+        failures.Inc();
+        return false;
+    }
+    (resumed ? resumed_latency : full_latency).Record(timer.ElapsedUs());
+    
+    // 流量捕获：握手完成后分配连接编号，随握手到达的第一条消息记在握手之后
+    m_capture_id = CaptureWriter::GetInstance().OpenConnection(resumed);
+    if (m_early_len >= 0) {
+        CaptureWriter::GetInstance().RecordFrame(m_capture_id, FRAME_CHAT, m_early_len,
+                                                 m_early_wire_len, CAPTURE_FLAG_EARLY);
+    }
+    return true;
+}
+
+// 服务端握手：问候、票据恢复或RSA密钥交换、签发新票据；resumed返回是否通过票据恢复
+// 握手在每个连接自己的线程上进行：RSA计算提交到加密线程池，线程池的大小限制了同时进行的RSA计算，
+// 握手线程在等待结果期间阻塞
+bool CTcpSocket::ServerHandshake(bool& resumed) {
+    CryptoWorkerPool& pool = CryptoWorkerPool::GetInstance();
+    
+    // 接收客户端问候，判断是否可以通过会话票据恢复
+    ClientHello hello;
+    {
+        TRACE_SPAN("handshake", "recv-hello");
+        if (RecvData((char*)&hello, sizeof(hello)) != sizeof(hello) || ntohl(hello.magic) != HELLO_MAGIC) {
+            LOG_ERROR("接收客户端问候失败");
+            return false;
+        }
+    }
+    
+    ServerHello reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.magic = htonl(HELLO_MAGIC);
+    reply.mode = htonl(HELLO_FULL);
+    uint32_t early_len = ntohl(hello.early_len);
+    char ticket_key[8];
+    if (ntohl(hello.mode) == HELLO_RESUME) {
+        TRACE_SPAN("handshake", "redeem-ticket");
+        bool replayed = false;
+        bool redeemed = m_tickets->Redeem(hello.ticket, ticket_key, replayed);
+        TicketCacheStats stats = m_tickets->GetStats();
+        char hit_rate[16];
+        snprintf(hit_rate, sizeof(hit_rate), "%.1f", stats.HitRate());
+        LOG_INFO(std::string("会话票据") + (redeemed ? "有效" : "无效或已过期") +
+                 "，缓存命中率: " + hit_rate + "% (" +
+                 std::to_string(stats.hits) + "/" + std::to_string(stats.hits + stats.misses) +
+                 ")，条目: " + std::to_string(stats.size) + "/" + std::to_string(stats.capacity) +
+                 "，淘汰: " + std::to_string(stats.evictions));
+        if (replayed) {
+            LOG_WARNING("客户端出示了已兑换过的票据（重放次数 " + std::to_string(stats.replays) +
+                        "），丢弃随问候到达的0-RTT消息");
+        }
+        if (redeemed) {
+            // 0-RTT消息只能使用客户端随机数导出的密钥，本次会话再加入服务端随机数导出新密钥
+            reply.mode = htonl(HELLO_RESUME);
+            unsigned char no_nonce[HELLO_NONCE_SIZE] = {0};
+            DeriveResumptionKey(ticket_key, hello.nonce, no_nonce, m_des_key);
+            ResetSessionKeys();
+        }
+    }
+    
+    // 问候之后附带的0-RTT消息：只在票据首次兑换时接受，否则丢弃（客户端会在密钥交换后重发），
+    // 因此重放截获的问候不会让同一条消息再次送达
+    resumed = ntohl(reply.mode) == HELLO_RESUME;
+    if (early_len > 0 && !RecvEarlyData(early_len, resumed)) {
+        memset(ticket_key, 0, sizeof(ticket_key));
+        return false;
+    }
+    if (resumed) {
+        FillRandom(reply.nonce, HELLO_NONCE_SIZE);
+        DeriveResumptionKey(ticket_key, hello.nonce, reply.nonce, m_des_key);
+        ResetSessionKeys();
+    }
+    memset(ticket_key, 0, sizeof(ticket_key));
+    
+    {
+        TRACE_SPAN("handshake", "send-hello");
+        if (!SendData((char*)&reply, sizeof(reply))) {
+            LOG_ERROR("发送服务端问候失败");
+            return false;
+        }
+    }
+    
+    // 旧票据已作废，为恢复后的会话签发新票据
+    if (resumed) {
+        TRACE_SPAN("handshake", "issue-ticket");
+        if (!IssueTicket()) {
+            LOG_WARNING("发送会话票据失败");
+        }
+        return true;
+    }
+    
+    // 完整握手：取一个预先生成的RSA密钥对
+    {
+        TRACE_SPAN("handshake", "wait-keygen");
+        m_rsa = RsaKeyPool::GetInstance().Take().get();
+    }
     
     // 获取公钥
     RSA::PublicKey pub_key = m_rsa.GetPublicKey();
     RSA::PrivateKey priv_key = m_rsa.GetPrivateKey();
     LOG_DEBUG("生成的RSA公钥: e=" + std::to_string(pub_key.e) + ", n=" + std::to_string(pub_key.n));
     LOG_DEBUG("生成的RSA私钥: d=" + std::to_string(priv_key.d) + ", n=" + std::to_string(priv_key.n));
-    std::cout << "[服务端] 已生成RSA密钥对" << std::endl;
+    if (!m_quiet) {
+        std::cout << "[服务端] 已生成RSA密钥对" << std::endl;
+    }
     
     // 发送公钥给客户端
     LOG_DEBUG("发送公钥 (e,n) = (" + std::to_string(pub_key.e) + "," + std::to_string(pub_key.n) + ")");
-    if (!SendData((char*)&pub_key, sizeof(pub_key))) {
-        LOG_ERROR("发送RSA公钥失败");
-        std::cerr << "[服务端] 发送公钥失败" << std::endl;
-        return false;
+    {
+        TRACE_SPAN("handshake", "send-pubkey");
+        if (!SendData((char*)&pub_key, sizeof(pub_key))) {
+            LOG_ERROR("发送RSA公钥失败");
+            std::cerr << "[服务端] 发送公钥失败" << std::endl;
+            return false;
+        }
     }
     LOG_INFO("已发送RSA公钥给客户端");
-    std::cout << "[服务端] 公钥交换完成" << std::endl;
+    if (!m_quiet) {
+        std::cout << "[服务端] 公钥交换完成" << std::endl;
+    }
     
     // 接收加密后的DES密钥
-    uint64_t encrypted_des_key[4];
-    int recv_bytes = RecvData((char*)encrypted_des_key, sizeof(encrypted_des_key));
-    if (recv_bytes <= 0) {
+    KeyExchange exchange;
+    uint64_t* encrypted_des_key = exchange.encrypted_key;
+    int recv_bytes;
+    {
+        TRACE_SPAN("handshake", "recv-key-exchange");
+        recv_bytes = RecvData((char*)&exchange, sizeof(exchange));
+    }
+    if (recv_bytes != sizeof(exchange)) {
         LOG_ERROR("接收加密DES密钥失败");
         std::cerr << "[服务端] 接收加密密钥失败" << std::endl;
         return false;
     }
     LOG_INFO("接收加密的DES密钥: " + std::to_string(recv_bytes) + " 字节");
-    std::cout << "[服务端] 已接收加密密钥" << std::endl;
+    if (!m_quiet) {
+        std::cout << "[服务端] 已接收加密密钥" << std::endl;
+    }
     
     // 记录加密后的DES密钥块到日志中
-    std::stringstream ss;
-    ss << "加密后的DES密钥块: ";
-    for(int i=0; i<4; i++) ss << encrypted_des_key[i] << " ";
-    LOG_DEBUG(ss.str());
+    LOG_DEBUGF("加密后的DES密钥块: %llu %llu %llu %llu",
+               (unsigned long long)encrypted_des_key[0], (unsigned long long)encrypted_des_key[1],
+               (unsigned long long)encrypted_des_key[2], (unsigned long long)encrypted_des_key[3]);
     
-    // 解密DES密钥
-    LOG_DEBUG("使用私钥解密DES密钥...");
-    unsigned short* key_parts = (unsigned short*)m_des_key;
+    // 检查是否超出n的范围
+    std::array<uint64_t, 4> blocks;
     for (int i = 0; i < 4; i++) {
-        std::stringstream ss_block;
-        ss_block << "解密块" << i << ": " << encrypted_des_key[i] << " -> ";
-        
-        // 检查是否超出n的范围
         if (encrypted_des_key[i] >= priv_key.n) {
             LOG_WARNING("密文值超出模数n的范围! 已修正为: " + std::to_string(encrypted_des_key[i] % priv_key.n));
             encrypted_des_key[i] %= priv_key.n;
         }
-        
-        key_parts[i] = (unsigned short)RSA::Decrypt(encrypted_des_key[i], priv_key);
-        ss_block << key_parts[i];
-        LOG_DEBUG(ss_block.str());
+        blocks[i] = encrypted_des_key[i];
     }
     
-    // 转换回主机字节序
+    // 私钥解密交给加密线程池执行，本连接等待结果
+    LOG_DEBUG("使用私钥解密DES密钥...");
+    std::future<std::array<uint64_t, 4> > decrypt_job = pool.Submit([blocks, priv_key]() {
+        std::array<uint64_t, 4> parts;
+        for (int i = 0; i < 4; i++) {
+            parts[i] = RSA::Decrypt(blocks[i], priv_key);
+        }
+        return parts;
+    });
+    std::array<uint64_t, 4> parts;
+    {
+        TRACE_SPAN("handshake", "rsa-decrypt");
+        parts = decrypt_job.get();
+    }
+    
+    // 每个密文块对应密钥中按大端序排列的两个字节
     for (int i = 0; i < 4; i++) {
-        key_parts[i] = ntohs(key_parts[i]);  // 从网络字节序转换回主机字节序
+        uint16_t part = (uint16_t)parts[i];
+        m_des_key[2 * i] = (char)(part >> 8);
+        m_des_key[2 * i + 1] = (char)(part & 0xFF);
+        LOG_DEBUG("解密块" + std::to_string(i) + ": " + std::to_string(blocks[i]) + " -> " + std::to_string(part));
     }
+    ResetSessionKeys();
+    
+    CryptoPoolStats pool_stats = pool.GetStats();
+    char pool_latency[64];
+    snprintf(pool_latency, sizeof(pool_latency), "平均 %.1f us，最大 %.1f us",
+             pool_stats.AvgLatencyUs(), pool_stats.max_latency_ns / 1000.0);
+    LOG_INFO("加密线程池: 队列深度 " + std::to_string(pool_stats.queue_depth) +
+             " (峰值 " + std::to_string(pool_stats.peak_depth) + ")，已完成任务 " +
+             std::to_string(pool_stats.completed) + "，任务延迟 " + pool_latency);
     
     // 记录DES密钥到日志
-    ss.str("");
-    ss << "[服务端] 解密后的DES密钥 (HEX): ";
-    for (int i = 0; i < 8; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(m_des_key[i])) << " ";
+    std::string key_hex = "[服务端] 解密后的DES密钥 (HEX): " + LogHexDump(m_des_key, 8);
+    LOG_DEBUG(key_hex);
+    if (!m_quiet) {
+        std::cout << key_hex << std::endl;
     }
-    LOG_DEBUG(ss.str());
-    std::cout << ss.str() << std::endl;
     
     // 将RSA密钥交换流程记录到日志中
     LOG_DEBUG("\n===== RSA密钥交换流程 =====\n"
@@ -195,10 +530,19 @@ bool CTcpSocket::StartSecureServer() {
               "| 使用私钥d解密   |       +-----------------+\n"
               "+-----------------+\n");
     
-    std::cout << "[服务端] 准备进入安全聊天模式..." << std::endl;
-                 
-    // 开始加密通信
-    return SecretChat(m_des_key, 8);
+    // 密钥交换消息后附带的第一条消息
+    early_len = ntohl(exchange.early_len);
+    if (early_len > 0 && !RecvEarlyData(early_len, true)) {
+        return false;
+    }
+    
+    // 签发会话票据，客户端重连时可跳过RSA密钥交换
+    TRACE_SPAN("handshake", "issue-ticket");
+    if (!IssueTicket()) {
+        LOG_WARNING("发送会话票据失败");
+    }
+    
+    return true;
 }
 
 // 连接到服务器并完成密钥交换
@@ -221,6 +565,20 @@ bool CTcpSocket::ConnectToServer(const char* server_ip, int port) {
         m_socket = -1;
         return false;
     }
+    if (m_io_timeout_ms > 0) {
+        ApplyIoTimeout(m_socket);
+    }
+    
+    // 启用TCP Fast Open后connect不会立即发送SYN，
+    // 第一次写入（客户端问候及0-RTT消息）将随SYN一起发出
+#ifdef TCP_FASTOPEN_CONNECT
+    if (m_fast_open) {
+        int opt = 1;
+        if (setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &opt, sizeof(opt)) < 0) {
+            perror("TCP Fast Open not available");
+        }
+    }
+#endif
     
     // 连接到服务器
     if (connect(m_socket, (struct sockaddr*)&m_server_addr, sizeof(m_server_addr)) < 0) {
@@ -230,7 +588,9 @@ bool CTcpSocket::ConnectToServer(const char* server_ip, int port) {
         return false;
     }
     
-    printf("连接成功！\n");
+    if (!m_quiet) {
+        printf("连接成功！\n");
+    }
     
     m_is_server = false;
     m_client_socket = m_socket; // 客户端模式下，client_socket与socket相同
@@ -252,18 +612,106 @@ bool CTcpSocket::StartSecureClient() {
     }
     
     LOG_INFO("开始RSA密钥交换和DES安全通信建立...");
-    std::cout << "\n[客户端] 正在建立安全通信..." << std::endl;
+    if (!m_quiet) {
+        std::cout << "\n[客户端] 正在建立安全通信..." << std::endl;
+    }
+    if (!EstablishSecureClient()) {
+        return false;
+    }
+    
+    // 开始加密通信
+    return SecretChat(m_des_key, 8);
+}
+
+// 客户端握手：问候（可携带票据与0-RTT消息）、必要时执行RSA密钥交换、接收新票据
+bool CTcpSocket::EstablishSecureClient() {
+    TRACE_SPAN("handshake", "client-handshake");
+    BufferArena arena;      // 握手期间的临时缓冲区，握手结束时一并归还
+    
+    // 发送客户端问候，如有该服务器签发的有效票据则请求恢复会话
+    ClientHello hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = htonl(HELLO_MAGIC);
+    hello.mode = htonl(HELLO_FULL);
+    ClientTicket saved;
+    const int hello_buf_size = sizeof(ClientHello) + FRAME_BUFFER_SIZE;
+    char* hello_buf = arena.Allocate(hello_buf_size);
+    int hello_len = sizeof(hello);
+    if (m_resumption && LoadClientTicket(CLIENT_TICKET_FILE, m_server_addr.sin_addr.s_addr, m_server_addr.sin_port, saved)) {
+        hello.mode = htonl(HELLO_RESUME);
+        memcpy(hello.ticket, saved.ticket, TICKET_BLOB_SIZE);
+        FillRandom(hello.nonce, HELLO_NONCE_SIZE);
+        LOG_INFO("找到有效会话票据，尝试恢复会话");
+        unsigned char no_nonce[HELLO_NONCE_SIZE] = {0};
+        DeriveResumptionKey(saved.key, hello.nonce, no_nonce, m_des_key);
+        ResetSessionKeys();
+        
+        // 0-RTT：用票据密钥与客户端随机数导出的密钥加密第一条消息，与问候一起发送
+        if (!m_early_data.empty()) {
+            int frame_len = BuildChatFrame(m_early_data.data(), m_early_data.size(),
+                                           hello_buf + sizeof(hello), hello_buf_size - sizeof(hello));
+            if (frame_len > 0) {
+                hello.early_len = htonl(frame_len);
+                hello_len += frame_len;
+            }
+        }
+    }
+    memcpy(hello_buf, &hello, sizeof(hello));
+    
+    // 问候与0-RTT消息在一次写入中发出，启用TCP Fast Open时随SYN到达服务器
+    ServerHello reply;
+    {
+        TRACE_SPAN("handshake", "hello-exchange");
+        if (!SendData(hello_buf, hello_len) ||
+            RecvData((char*)&reply, sizeof(reply)) != sizeof(reply) || ntohl(reply.magic) != HELLO_MAGIC) {
+            LOG_ERROR("握手问候交换失败");
+            std::cerr << "[客户端] 握手失败" << std::endl;
+            return false;
+        }
+    }
+    
+    if (ntohl(reply.mode) == HELLO_RESUME) {
+        DeriveResumptionKey(saved.key, hello.nonce, reply.nonce, m_des_key);
+        ResetSessionKeys();
+        memset(&saved, 0, sizeof(saved));
+        LOG_INFO("会话已通过票据恢复");
+        if (!m_quiet) {
+            std::cout << "[客户端] 会话已通过票据恢复，跳过RSA密钥交换" << std::endl;
+        }
+        if (!m_early_data.empty()) {
+            if (!m_quiet) {
+                std::cout << "[发送] " << m_early_data << std::endl;
+            }
+            m_early_data.clear();
+        }
+        
+        // 用过的票据已被服务端作废，换成为本次会话签发的新票据
+        TRACE_SPAN("handshake", "recv-ticket");
+        if (!ReceiveTicket()) {
+            LOG_WARNING("接收会话票据失败，下次连接将执行完整密钥交换");
+        }
+        return true;
+    }
+    if (ntohl(hello.mode) == HELLO_RESUME) {
+        LOG_INFO("服务器拒绝会话票据，执行完整密钥交换");
+    }
     
     // 接收服务器的RSA公钥
     RSA::PublicKey pub_key;
-    int recv_bytes = RecvData((char*)&pub_key, sizeof(pub_key));
+    int recv_bytes;
+    {
+        TRACE_SPAN("handshake", "recv-pubkey");
+        recv_bytes = RecvData((char*)&pub_key, sizeof(pub_key));
+    }
     if (recv_bytes <= 0) {
         LOG_ERROR("接收RSA公钥失败");
         std::cerr << "[客户端] 接收服务器公钥失败" << std::endl;
         return false;
     }
     LOG_DEBUG("已接收服务器RSA公钥: e=" + std::to_string(pub_key.e) + ", n=" + std::to_string(pub_key.n));
-    std::cout << "[客户端] 已接收服务器公钥" << std::endl;
+    if (!m_quiet) {
+        std::cout << "[客户端] 已接收服务器公钥" << std::endl;
+    }
     
     // 验证接收到的公钥是否合法
     if (pub_key.e == 0 || pub_key.n == 0) {
@@ -274,37 +722,71 @@ bool CTcpSocket::StartSecureClient() {
     
     // 生成随机DES密钥
     GenerateDesKey(m_des_key, 8);
-    std::stringstream ss_key;
-    for (int i = 0; i < 8; i++) {
-        ss_key << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(m_des_key[i])) << " ";
-    }
-    LOG_DEBUG("已生成随机DES密钥 (HEX): " + ss_key.str());
+    ResetSessionKeys();
+    LOG_DEBUG("已生成随机DES密钥 (HEX): " + LogHexDump(m_des_key, 8));
     
-    // 加密DES密钥
+    // 加密DES密钥，每两个字节按大端序组成一个明文块，与字节序无关
     LOG_DEBUG("使用RSA公钥加密DES密钥...");
-    uint64_t encrypted_des_key[4];
-    unsigned short* key_parts = (unsigned short*)m_des_key;
+    KeyExchange exchange;
+    memset(&exchange, 0, sizeof(exchange));
+    uint64_t* encrypted_des_key = exchange.encrypted_key;
     for (int i = 0; i < 4; i++) {
-        LOG_DEBUG("加密块" + std::to_string(i) + ": " + std::to_string(key_parts[i]));
+        TRACE_SPAN("handshake", "rsa-encrypt-block");
+        uint64_t part = ((uint64_t)(unsigned char)m_des_key[2 * i] << 8) |
+                        (unsigned char)m_des_key[2 * i + 1];
+        LOG_DEBUG("加密块" + std::to_string(i) + ": " + std::to_string(part));
         
         // 确保明文小于模数n
-        if (key_parts[i] >= pub_key.n) {
+        if (part >= pub_key.n) {
             LOG_WARNING("明文值超过模数n，将被截断");
-            key_parts[i] %= pub_key.n;
+            part %= pub_key.n;
         }
         
-        encrypted_des_key[i] = RSA::Encrypt((uint64_t)key_parts[i], pub_key);
+        encrypted_des_key[i] = RSA::Encrypt(part, pub_key);
         LOG_DEBUG("块" + std::to_string(i) + "加密结果: " + std::to_string(encrypted_des_key[i]));
     }
     
+    // 第一条消息附在密钥交换消息之后，服务端无需等待下一轮即可收到
+    const int exchange_buf_size = sizeof(KeyExchange) + FRAME_BUFFER_SIZE;
+    char* exchange_buf = arena.Allocate(exchange_buf_size);
+    int exchange_len = sizeof(exchange);
+    if (!m_early_data.empty()) {
+        int frame_len = BuildChatFrame(m_early_data.data(), m_early_data.size(),
+                                       exchange_buf + sizeof(exchange), exchange_buf_size - sizeof(exchange));
+        if (frame_len > 0) {
+            exchange.early_len = htonl(frame_len);
+            exchange_len += frame_len;
+        }
+    }
+    memcpy(exchange_buf, &exchange, sizeof(exchange));
+    
     // 发送加密后的DES密钥
-    if (!SendData((char*)encrypted_des_key, sizeof(encrypted_des_key))) {
-        LOG_ERROR("发送加密DES密钥失败");
-        std::cerr << "[客户端] 加密密钥交换失败" << std::endl;
-        return false;
+    {
+        TRACE_SPAN("handshake", "send-key-exchange");
+        if (!SendData(exchange_buf, exchange_len)) {
+            LOG_ERROR("发送加密DES密钥失败");
+            std::cerr << "[客户端] 加密密钥交换失败" << std::endl;
+            return false;
+        }
     }
     LOG_INFO("已发送加密的DES密钥给服务器");
-    std::cout << "[客户端] 密钥交换成功" << std::endl;
+    if (!m_quiet) {
+        std::cout << "[客户端] 密钥交换成功" << std::endl;
+    }
+    if (!m_early_data.empty()) {
+        if (!m_quiet) {
+            std::cout << "[发送] " << m_early_data << std::endl;
+        }
+        m_early_data.clear();
+    }
+    
+    // 接收会话票据，供下次重连使用
+    {
+        TRACE_SPAN("handshake", "recv-ticket");
+        if (!ReceiveTicket()) {
+            LOG_WARNING("接收会话票据失败，下次连接将执行完整密钥交换");
+        }
+    }
     
     // 将RSA密钥交换流程记录到日志中
     LOG_DEBUG("\n===== RSA密钥交换流程 =====\n"
@@ -316,40 +798,10 @@ bool CTcpSocket::StartSecureClient() {
               "| 使用私钥d解密   |       | 发送密文        |\n"
               "+-----------------+       +-----------------+\n");
     
-    // 执行边界值验证测试（只写入日志文件，不在控制台显示）
-    LOG_DEBUG("执行RSA数学边界值验证...");
-    // 创建临时RSA对象用于测试
-    RSA test_rsa;
-    test_rsa.GenerateKeys(8); // 使用较小的素数便于观察
-    RSA::TestEdgeCases(test_rsa);
-    
-    // 测试用例验证（只写入日志文件）
-    uint64_t test_plain = 42;
-    LOG_DEBUG("RSA完整性验证测试");
-    LOG_DEBUG("测试明文: " + std::to_string(test_plain));
-    
-    auto test_pub = test_rsa.GetPublicKey();
-    uint64_t test_cipher = RSA::Encrypt(test_plain, test_pub);
-    uint64_t test_decrypted = RSA::Decrypt(test_cipher, test_rsa.GetPrivateKey());
-    
-    LOG_DEBUG("验证结果: 原始明文=" + std::to_string(test_plain) + 
-              " | 解密结果=" + std::to_string(test_decrypted) + 
-              " | 是否一致: " + std::to_string(test_plain == test_decrypted));
-    
-    // 检测基于当前公钥的实际加密测试（只写入日志文件）
-    LOG_DEBUG("执行实际公钥验证测试...");
-    uint64_t real_test = 12345;
-    if (real_test < pub_key.n) {
-        uint64_t real_cipher = RSA::Encrypt(real_test, pub_key);
-        LOG_DEBUG("测试值: " + std::to_string(real_test) + " -> 加密后: " + std::to_string(real_cipher));
-    } else {
-        LOG_DEBUG("跳过实际公钥测试: 测试值大于模数");
+    if (!m_quiet) {
+        std::cout << "[客户端] 准备进入安全聊天模式..." << std::endl;
     }
-    
-    std::cout << "[客户端] 准备进入安全聊天模式..." << std::endl;
-    
-    // 开始加密通信
-    return SecretChat(m_des_key, 8);
+    return true;
 }
 
 // 生成随机DES密钥
@@ -364,28 +816,63 @@ void CTcpSocket::GenerateDesKey(char* key, int key_len) {
     }
     
     // 记录生成的密钥到日志
-    std::stringstream ss;
-    ss << "[客户端] 生成的DES密钥 (HEX): ";
-    for (int i = 0; i < key_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(key[i])) << " ";
+    std::string key_hex = "[客户端] 生成的DES密钥 (HEX): " + LogHexDump(key, key_len);
+    LOG_DEBUG(key_hex);
+    if (!m_quiet) {
+        std::cout << key_hex << std::endl;
+    }
+}
+
+// 签发并发送会话票据（服务端）
+bool CTcpSocket::IssueTicket() {
+    TicketGrant grant;
+    unsigned char expiry_be[8];
+    int64_t expiry = m_tickets->Issue(m_des_key, grant.ticket);
+    PutBigEndian64(expiry_be, (uint64_t)expiry);
+    memcpy(&grant.expiry, expiry_be, sizeof(expiry_be));
+    
+    // 票据本身只有服务端能解开，但仍使用会话密钥加密后再下发
+    char encrypted[sizeof(TicketGrant)];
+    int encrypted_len = sizeof(encrypted);
+    if (!m_des.Encry((char*)&grant, sizeof(grant), encrypted, encrypted_len, m_des_key, 8)) {
+        return false;
+    }
+    if (!SendData(encrypted, encrypted_len)) {
+        return false;
+    }
+    LOG_INFO("已签发会话票据，有效期至 " + std::to_string(expiry));
+    return true;
+}
+
+// 接收并保存会话票据（客户端）
+bool CTcpSocket::ReceiveTicket() {
+    char encrypted[sizeof(TicketGrant)];
+    if (RecvData(encrypted, sizeof(encrypted)) != (int)sizeof(encrypted)) {
+        return false;
     }
-    LOG_DEBUG(ss.str());
-    std::cout << ss.str() << std::endl;
     
-    // 确保密钥在网络传输前转换为网络字节序
-    // 这样服务端解密后可以正确还原密钥
-    uint16_t* p = reinterpret_cast<uint16_t*>(key);
-    for (int i = 0; i < key_len/2; i++) {
-        p[i] = htons(p[i]);  // 转换为网络字节序
+    TicketGrant grant;
+    int grant_len = sizeof(grant);
+    if (!m_des.Decry(encrypted, sizeof(encrypted), (char*)&grant, grant_len, m_des_key, 8)) {
+        return false;
+    }
+    if (!m_resumption) {
+        return true;
     }
     
-    // 记录转换后的密钥到日志（仅调试用）
-    std::stringstream ss_network;
-    ss_network << "[客户端] 转换为网络字节序后的DES密钥 (HEX): ";
-    for (int i = 0; i < key_len; i++) {
-        ss_network << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(key[i])) << " ";
+    ClientTicket ticket;
+    memset(&ticket, 0, sizeof(ticket));
+    ticket.server_ip = m_server_addr.sin_addr.s_addr;
+    ticket.port = m_server_addr.sin_port;
+    ticket.expiry = (int64_t)GetBigEndian64((unsigned char*)&grant.expiry);
+    memcpy(ticket.key, m_des_key, 8);
+    memcpy(ticket.ticket, grant.ticket, TICKET_BLOB_SIZE);
+    bool ok = SaveClientTicket(CLIENT_TICKET_FILE, ticket);
+    memset(&ticket, 0, sizeof(ticket));
+    if (ok) {
+        LOG_INFO("已保存会话票据");
     }
-    LOG_DEBUG(ss_network.str());
+    return ok;
 }
 
 // 发送数据
@@ -401,21 +888,28 @@ bool CTcpSocket::SendData(const char* data, int data_len) {
     int bytes_left = data_len;
     int n;
     
+    static MetricCounter& send_bytes = MetricsRegistry::GetInstance().Counter(
+        "chat_send_bytes_total", "已发送字节数");
+    static MetricCounter& send_calls = MetricsRegistry::GetInstance().Counter(
+        "chat_send_syscalls_total", "send系统调用次数");
+    
     while (total_sent < data_len) {
-        n = send(sockfd, data + total_sent, bytes_left, 0);
+        n = send(sockfd, data + total_sent, bytes_left, MSG_NOSIGNAL);   // 对端已关闭时返回EPIPE而不是终止进程
+        send_calls.Inc();
         if (n < 0) {
             LOG_ERROR("发送数据失败: " + std::string(strerror(errno)));
-            perror("send failed");
+            if (!m_quiet) {
+                perror("send failed");
+            }
             return false;
         }
         total_sent += n;
         bytes_left -= n;
     }
+    send_bytes.Add(total_sent);
     
     // 记录发送数据的详细信息到日志
-    std::stringstream ss;
-    ss << "发送数据完成: 总计 " << total_sent << " 字节";
-    LOG_DEBUG(ss.str());
+    LOG_RECORD(DEBUG, LOGF_SEND_DONE, total_sent);
     
     return true;
 }
@@ -433,13 +927,21 @@ int CTcpSocket::RecvData(char* buffer, int buffer_size) {
     int bytesleft = buffer_size;
     int n;
     
+    static MetricCounter& recv_bytes = MetricsRegistry::GetInstance().Counter(
+        "chat_recv_bytes_total", "已接收字节数");
+    static MetricCounter& recv_calls = MetricsRegistry::GetInstance().Counter(
+        "chat_recv_syscalls_total", "recv系统调用次数");
+    
     while (total < buffer_size) {
         n = recv(sockfd, buffer + total, bytesleft, 0);
+        recv_calls.Inc();
         if (n <= 0) {
             // 出错或连接关闭
             if (n < 0) {
                 LOG_ERROR("接收数据失败: " + std::string(strerror(errno)));
-                perror("recv failed");
+                if (!m_quiet) {
+                    perror("recv failed");
+                }
             } else {
                 LOG_INFO("连接关闭");
             }
@@ -447,15 +949,14 @@ int CTcpSocket::RecvData(char* buffer, int buffer_size) {
         }
         
         // 记录每次接收的数据块详情
-        std::stringstream ss;
-        ss << "接收数据块: " << n << " 字节，累计: " << (total + n) << "/" << buffer_size;
-        LOG_DEBUG(ss.str());
+        LOG_RECORD(DEBUG, LOGF_RECV_CHUNK, n, total + n, buffer_size);
         
+        recv_bytes.Add(n);
         total += n;
         bytesleft -= n;
     }
     
-    LOG_DEBUG("已完整接收所需数据: " + std::to_string(total) + " 字节");
+    LOG_RECORD(DEBUG, LOGF_RECV_DONE, total);
     return total;
 }
 
@@ -494,19 +995,838 @@ void CTcpSocket::CloseSocket() {
     }
 }
 
+// 关闭当前客户端连接，保留监听套接字以便继续接受连接
+void CTcpSocket::CloseClientSocket() {
+    if (m_client_socket >= 0 && m_client_socket != m_socket) {
+        close(m_client_socket);
+    }
+    m_client_socket = -1;
+}
+
+// 取走当前连接的描述符，之后由调用方负责关闭
+int CTcpSocket::DetachClient() {
+    int fd = m_client_socket;
+    if (m_socket == fd) {
+        m_socket = -1;          // 客户端模式下连接就是m_socket
+    }
+    m_client_socket = -1;
+    m_capture_id = 0;
+    return fd;
+}
+
+// 关闭当前连接的读写两个方向，描述符在CloseClientSocket时释放
+void CTcpSocket::ShutdownConnection() {
+    if (m_client_socket >= 0) {
+        shutdown(m_client_socket, SHUT_RDWR);
+    }
+}
+
+// 设置连接与收发超时：已连接时立即生效，之后建立的连接同样生效。
+// 超时后connect/send/recv失败返回，握手随之失败
+void CTcpSocket::SetIoTimeout(int timeout_ms) {
+    m_io_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+    if (m_client_socket >= 0) {
+        ApplyIoTimeout(m_client_socket);
+    }
+}
+
+void CTcpSocket::ApplyIoTimeout(int fd) {
+    struct timeval timeout;
+    timeout.tv_sec = m_io_timeout_ms / 1000;
+    timeout.tv_usec = m_io_timeout_ms % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// 设置随密钥交换一并发送的第一条消息（0-RTT）
+void CTcpSocket::SetEarlyData(const char* data, int data_len) {
+    if (data_len >= BUFFER_SIZE) {
+        data_len = BUFFER_SIZE - 1;
+    }
+    m_early_data.assign(data, data_len);
+}
+
+// 加密并封装一帧，返回帧总长度，失败返回-1
+int CTcpSocket::BuildFrame(uint8_t type, const char* data, int data_len, char* frame, int frame_size) {
+    int frame_len = SealFrame(m_des, m_send_keys, m_send_seq, type, data, data_len, frame, frame_size);
+    if (frame_len > 0) {
+        m_send_seq++;
+    }
+    return frame_len;
+}
+
+// 以序号seq加密并封装一帧：按帧序号选择密钥（换钥后从生效序号开始使用新密钥），返回帧长度
+int CTcpSocket::SealFrame(const CDesOperate& des, SessionKeyRing& keys, uint32_t seq, uint8_t type,
+                          const char* data, int data_len, char* frame, int frame_size) {
+    return SealFrame(des, keys.ForSeq(seq), seq, type, data, data_len, frame, frame_size);
+}
+
+// 以指定的密钥编排加密并封装一帧；帧序号不参与校验和，预先加密的帧可以在发送时再填写序号
+int CTcpSocket::SealFrame(const CDesOperate& des, const DesKeySchedule& schedule, uint32_t seq, uint8_t type,
+                          const char* data, int data_len, char* frame, int frame_size) {
+    if (frame_size < (int)sizeof(FrameHeader)) {
+        return -1;
+    }
+    
+    char* payload = frame + sizeof(FrameHeader);
+    int encrypted_len = frame_size - sizeof(FrameHeader);
+    {
+        TRACE_SPAN("chat", "encrypt");
+        if (!des.Encry(data, data_len, payload, encrypted_len, schedule)) {
+            return -1;
+        }
+    }
+    
+    // 填写帧头并计算校验和
+    FrameHeader header;
+    header.length = htonl(encrypted_len);
+    header.type = type;
+    header.flags = 0;
+    header.reserved = 0;
+    header.seq = htonl(seq);
+    {
+        TRACE_SPAN("chat", "checksum");
+        header.checksum = htonl(FrameChecksum(payload, encrypted_len));
+    }
+    memcpy(frame, &header, sizeof(header));
+    
+    // 详细加密信息写入日志
+    LOG_RECORD(DEBUG, LOGF_FRAME_SENT, ntohl(header.checksum), LogBytes(payload, encrypted_len), encrypted_len, seq);
+    
+    return sizeof(FrameHeader) + encrypted_len;
+}
+
+// 加密并封装聊天消息帧
+int CTcpSocket::BuildChatFrame(const char* text, int text_len, char* frame, int frame_size) {
+    return BuildFrame(FRAME_CHAT, text, text_len, frame, frame_size);
+}
+
+// 达到字节数或时间阈值时，先在当前序号处换钥，下一帧即使用新密钥
+bool CTcpSocket::RekeyIfDue() {
+    bool bytes_due = m_rekey_bytes > 0 && m_bytes_since_rekey >= m_rekey_bytes;
+    bool time_due = m_rekey_seconds > 0 && time(nullptr) - m_last_rekey >= m_rekey_seconds;
+    return !(bytes_due || time_due) || SendRekey();
+}
+
+// 发送一条聊天消息
+bool CTcpSocket::SendChatMessage(const char* text, int text_len) {
+    LaneGuard lane(m_lanes, LANE_CHAT);
+    if (!RekeyIfDue()) {
+        return false;
+    }
+    
+    char frame[FRAME_BUFFER_SIZE];
+    int frame_len = BuildChatFrame(text, text_len, frame, sizeof(frame));
+    if (frame_len < 0) {
+        LOG_ERROR("消息加密失败");
+        return false;
+    }
+    m_bytes_since_rekey += frame_len;
+    TRACE_SPAN("chat", "send");
+    return SendData(frame, frame_len);
+}
+
+// 加密并发送一个控制帧
+bool CTcpSocket::SendControlFrame(uint8_t type, const char* data, int data_len) {
+    LaneGuard lane(m_lanes, LANE_CONTROL);
+    char frame[FRAME_BUFFER_SIZE];
+    int frame_len = BuildFrame(type, data, data_len, frame, sizeof(frame));
+    return frame_len > 0 && SendData(frame, frame_len);
+}
+
+// 设置批量数据的块大小：块越小，聊天消息等待正在写入的块的时间越短，每块的帧头与加锁开销占比越高
+void CTcpSocket::SetBulkChunkSize(int bytes) {
+    m_bulk_chunk = std::max(512, std::min(bytes, BULK_CHUNK_MAX));
+}
+
+// 批量数据的一块：明文、加密后的帧与加密所用的密钥编排
+struct BulkSlot {
+    PooledBuffer plain;
+    PooledBuffer frame;
+    DesKeySchedule schedule;
+    uint32_t key_version;      // schedule对应的发送密钥版本
+    uint64_t sent;             // 本块在这次发送中的起始位置
+    int chunk;                 // 本块数据长度
+    int frame_len;
+};
+
+bool CTcpSocket::SendBulk(uint32_t stream_id, const char* data, uint64_t len, uint64_t offset, bool last) {
+    return SendBulk(stream_id, [data, offset](char* out, uint64_t pos, int n) {
+        if (n > 0) {
+            memcpy(out, data + (pos - offset), n);
+        }
+        return true;
+    }, len, offset, last);
+}
+
+// 在批量通道上发送一段数据。两块交替流水：写入第N块的同时，第N+1块在加密线程池上读入并用下一帧的密钥预先加密，
+// 内存只占两块。取得批量通道后只填写序号并写入，随即释放，等待中的控制帧与聊天消息在块之间写入；
+// 预先加密期间发生换钥时在锁内重新加密
+bool CTcpSocket::SendBulk(uint32_t stream_id, const BulkReader& read, uint64_t len, uint64_t offset, bool last) {
+    static MetricCounter& bulk_bytes = MetricsRegistry::GetInstance().Counter(
+        "chat_bulk_bytes_sent_total", "批量通道已发送的数据字节数");
+    int chunk_size = m_bulk_chunk;
+    BulkSlot slots[2];
+    for (int i = 0; i < 2; i++) {
+        slots[i].plain = PooledBuffer(sizeof(BulkChunkHeader) + chunk_size);
+        slots[i].frame = PooledBuffer(sizeof(FrameHeader) + sizeof(BulkChunkHeader) + chunk_size + 8);
+    }
+    
+    // 读入并加密从sent开始的一块
+    auto prepare = [&](BulkSlot& slot, uint64_t sent) {
+        slot.sent = sent;
+        slot.chunk = (int)std::min<uint64_t>(len - sent, chunk_size);
+        BulkChunkHeader* header = (BulkChunkHeader*)slot.plain.data();
+        memset(header, 0, sizeof(*header));
+        header->stream_id = htonl(stream_id);
+        header->length = htonl(slot.chunk);
+        PutBigEndian64(header->offset, offset + sent);
+        header->flags = htonl(last && sent + slot.chunk == len ? BULK_FLAG_LAST : 0);
+        if (!read(slot.plain.data() + sizeof(BulkChunkHeader), offset + sent, slot.chunk)) {
+            return false;
+        }
+        slot.frame_len = SealFrame(m_des, slot.schedule, 0, FRAME_BULK, slot.plain.data(),
+                                   sizeof(BulkChunkHeader) + slot.chunk, slot.frame.data(), slot.frame.capacity());
+        return slot.frame_len > 0;
+    };
+    
+    // 最新的发送密钥：预先加密的块从这里复制，锁内发现换钥时更新
+    DesKeySchedule key;
+    uint32_t key_version;
+    {
+        LaneGuard lane(m_lanes, LANE_BULK);
+        key_version = NextSendKey(key);
+    }
+    slots[0].schedule = key;
+    slots[0].key_version = key_version;
+    bool ok = prepare(slots[0], 0);
+    for (int i = 0; ok; i++) {
+        BulkSlot& slot = slots[i & 1];
+        uint64_t following = slot.sent + slot.chunk;
+        std::future<bool> next;
+        if (following < len) {
+            BulkSlot& other = slots[(i + 1) & 1];
+            other.schedule = key;
+            other.key_version = key_version;
+            next = CryptoWorkerPool::GetInstance().Submit([&prepare, &other, following]() {
+                return prepare(other, following);
+            });
+        }
+        
+        {
+            LaneGuard lane(m_lanes, LANE_BULK);
+            ok = RekeyIfDue();
+            if (ok && m_send_key_version != slot.key_version) {
+                key_version = NextSendKey(key);
+                slot.schedule = key;
+                slot.key_version = key_version;
+                SealFrame(m_des, slot.schedule, 0, FRAME_BULK, slot.plain.data(), sizeof(BulkChunkHeader) + slot.chunk,
+                          slot.frame.data(), slot.frame.capacity());
+            }
+            if (ok) {
+                ((FrameHeader*)slot.frame.data())->seq = htonl(m_send_seq++);
+                m_bytes_since_rekey += slot.frame_len;
+                ok = SendData(slot.frame.data(), slot.frame_len);
+            }
+        }
+        if (ok) {
+            bulk_bytes.Add(slot.chunk);
+        }
+        // 下一块引用本函数的局部变量，返回之前必须等它完成
+        if (next.valid()) {
+            bool prepared = next.get();
+            ok = ok && prepared;
+        }
+        if (following >= len) {
+            break;
+        }
+    }
+    if (!ok) {
+        LOG_ERROR("批量数据发送失败");
+    }
+    return ok;
+}
+
+// 复制下一帧将使用的密钥编排：换钥控制帧之后的第一帧在这里完成切换
+uint32_t CTcpSocket::NextSendKey(DesKeySchedule& schedule) {
+    schedule = m_send_keys.ForSeq(m_send_seq);
+    return m_send_key_version;
+}
+
+// 发送一个延迟探测帧，时间戳在加密之前取得，往返时间包含两端的加密、传输与解密
+// size大于PingPayload时以零填充，用于测量不同长度消息的延迟
+bool CTcpSocket::SendPing(int size) {
+    char payload[BUFFER_SIZE];
+    if (size < (int)sizeof(PingPayload)) {
+        size = sizeof(PingPayload);
+    } else if (size > BUFFER_SIZE) {
+        size = BUFFER_SIZE;
+    }
+    memset(payload, 0, size);
+    
+    PingPayload* ping = (PingPayload*)payload;
+    ping->probe_seq = htonl(m_probe_seq++);
+    PutBigEndian64(ping->sent_mono, TraceNowNs());
+    PutBigEndian64(ping->sent_real, RealtimeNs());
+    return SendControlFrame(FRAME_PING, payload, size);
+}
+
+// 回应对端的探测帧：填写解密完成的时间后连同填充原样发回
+bool CTcpSocket::HandlePing(const char* plain, int plain_len) {
+    if (plain_len < (int)sizeof(PingPayload) || plain_len > BUFFER_SIZE) {
+        LOG_WARNING("探测帧长度非法: " + std::to_string(plain_len) + " 字节");
+        return true;
+    }
+    char echo[BUFFER_SIZE];
+    memcpy(echo, plain, plain_len);
+    PutBigEndian64(((PingPayload*)echo)->peer_recv_real, RealtimeNs());
+    if (!SendControlFrame(FRAME_ECHO, echo, plain_len)) {
+        LOG_WARNING("发送探测应答失败");
+        return false;
+    }
+    return true;
+}
+
+// 批量数据块到达：按块头取出数据交给回调
+void CTcpSocket::HandleBulk(const char* plain, int plain_len) {
+    static MetricCounter& bulk_bytes = MetricsRegistry::GetInstance().Counter(
+        "chat_bulk_bytes_received_total", "批量通道已接收的数据字节数");
+    BulkChunkHeader header;
+    if (plain_len < (int)sizeof(header)) {
+        LOG_WARNING("批量数据块长度不足: " + std::to_string(plain_len) + " 字节");
+        return;
+    }
+    memcpy(&header, plain, sizeof(header));
+    int length = ntohl(header.length);
+    if (length < 0 || length > plain_len - (int)sizeof(header)) {
+        LOG_WARNING("批量数据块长度非法: " + std::to_string(length) + " 字节");
+        return;
+    }
+    bulk_bytes.Add(length);
+    uint32_t stream_id = ntohl(header.stream_id);
+    uint64_t offset = GetBigEndian64(header.offset);
+    bool last = (ntohl(header.flags) & BULK_FLAG_LAST) != 0;
+    if (!m_file_in.Active() || stream_id != m_file_in.StreamId()) {
+        if (m_on_bulk) {
+            m_on_bulk(stream_id, offset, plain + sizeof(header), length, last);
+        }
+        return;
+    }
+    
+    // 接收中的文件：按偏移写入，每FILE_ACK_BYTES记录进度并确认一次，最后一块写完后改名
+    if (!m_file_in.Write(offset, plain + sizeof(header), length)) {
+        AbortIncomingFile("写入失败");
+        return;
+    }
+    if (!last && m_file_in.Received() - m_file_in.Acked() < FILE_ACK_BYTES) {
+        return;
+    }
+    if (!m_file_in.Checkpoint()) {
+        AbortIncomingFile("记录进度失败");
+        return;
+    }
+    if (!last) {
+        SendFileControl(stream_id, FILE_ACK, m_file_in.Received());
+        return;
+    }
+    uint64_t size = m_file_in.Size();
+    if (!m_file_in.Finish()) {
+        AbortIncomingFile("文件不完整或改名失败");
+        return;
+    }
+    static MetricCounter& files_received = MetricsRegistry::GetInstance().Counter(
+        "chat_files_received_total", "接收完成的文件数");
+    files_received.Inc();
+    SendFileControl(stream_id, FILE_DONE, size);
+    LOG_INFO("文件接收完成: " + m_file_in.Path());
+    if (!m_quiet) {
+        std::cout << "[文件] 已接收 " << m_file_in.Path() << "（" << size << " 字节）" << std::endl;
+    }
+}
+
+// 加密并发送一个文件传输控制帧
+bool CTcpSocket::SendFileControl(uint32_t stream_id, uint32_t op, uint64_t offset, uint64_t size, int64_t mtime,
+                                 const char* name) {
+    FileControl control;
+    memset(&control, 0, sizeof(control));
+    control.stream_id = htonl(stream_id);
+    control.op = htonl(op);
+    PutBigEndian64(control.size, size);
+    PutBigEndian64(control.mtime, (uint64_t)mtime);
+    PutBigEndian64(control.offset, offset);
+    strncpy(control.name, name, FILE_NAME_MAX - 1);
+    return SendControlFrame(FRAME_FILE, (char*)&control, sizeof(control));
+}
+
+// 放弃接收中的文件：已确认的部分保留，对端可以稍后续传
+void CTcpSocket::AbortIncomingFile(const char* reason) {
+    LOG_ERROR("文件接收失败（" + std::string(reason) + "）: " + m_file_in.Path());
+    if (!m_quiet) {
+        std::cerr << "[文件] 接收失败（" << reason << "）: " << m_file_in.Path() << std::endl;
+    }
+    SendFileControl(m_file_in.StreamId(), FILE_ABORT, m_file_in.Acked());
+    m_file_in.Close();
+}
+
+// 文件传输控制帧：发送方发来的FILE_OFFER在这里准备接收，接收方的回复交给等待中的传输线程
+void CTcpSocket::HandleFileControl(const char* plain, int plain_len) {
+    if (plain_len < (int)sizeof(FileControl)) {
+        LOG_WARNING("文件传输控制帧长度不足: " + std::to_string(plain_len) + " 字节");
+        return;
+    }
+    FileControl control;
+    memcpy(&control, plain, sizeof(control));
+    control.name[FILE_NAME_MAX - 1] = '\0';
+    uint32_t stream_id = ntohl(control.stream_id);
+    uint32_t op = ntohl(control.op);
+    uint64_t offset = GetBigEndian64(control.offset);
+    
+    if (op == FILE_OFFER) {
+        // 同一时间只接收一个文件，新的文件到达时旧的保留进度
+        uint64_t size = GetBigEndian64(control.size);
+        uint64_t resume = 0;
+        if (!m_file_in.Open(m_recv_dir, stream_id, control.name, size, (int64_t)GetBigEndian64(control.mtime), resume)) {
+            LOG_ERROR("无法接收文件: " + std::string(control.name) + " (" + strerror(errno) + ")");
+            SendFileControl(stream_id, FILE_ABORT, 0);
+            return;
+        }
+        if (resume > 0) {
+            static MetricCounter& files_resumed = MetricsRegistry::GetInstance().Counter(
+                "chat_files_resumed_total", "从上次确认的偏移续传的文件数");
+            files_resumed.Inc();
+        }
+        LOG_INFO("开始接收文件 " + m_file_in.Path() + "，" + std::to_string(size) + " 字节，起始偏移 " +
+                 std::to_string(resume));
+        if (!m_quiet) {
+            std::cout << "[文件] 开始接收 " << control.name << "（" << size << " 字节";
+            if (resume > 0) {
+                std::cout << "，从 " << resume << " 字节处续传";
+            }
+            std::cout << "）" << std::endl;
+        }
+        if (!SendFileControl(stream_id, FILE_ACCEPT, resume)) {
+            m_file_in.Close();
+        }
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_file_out.mutex);
+    if (stream_id == 0 || stream_id != m_file_out.stream_id) {
+        return;
+    }
+    if (op == FILE_ACCEPT) {
+        m_file_out.resume_offset = offset;
+        m_file_out.acked = offset;
+    } else if (op == FILE_ACK || op == FILE_DONE) {
+        m_file_out.acked = offset;
+    }
+    if (op != FILE_ACK) {
+        m_file_out.reply = op;
+    }
+    m_file_out.cond.notify_all();
+}
+
+// 发送一个文件：发出FILE_OFFER，按对端给出的起始偏移分块读取并在批量通道上发送，等待对端确认写完。
+// 文件用pread按块读取，与加密一起在流水的下一块上进行，内存只占两块
+bool CTcpSocket::SendFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        LOG_ERROR("无法读取文件: " + path);
+        if (!m_quiet) {
+            std::cerr << "[文件] 无法读取文件: " << path << std::endl;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    uint64_t size = st.st_size;
+    
+    uint32_t stream_id;
+    {
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        stream_id = m_next_stream++;
+        m_file_out.stream_id = stream_id;
+        m_file_out.reply = 0;
+        m_file_out.resume_offset = 0;
+        m_file_out.acked = 0;
+    }
+    
+    // 等待对端回复，超时、连接关闭或对端放弃时返回0
+    auto await_reply = [this]() {
+        std::unique_lock<std::mutex> lock(m_file_out.mutex);
+        m_file_out.cond.wait_for(lock, std::chrono::milliseconds(FILE_REPLY_TIMEOUT_MS), [this]() {
+            return m_file_out.reply != 0 || m_file_out.closed;
+        });
+        int reply = m_file_out.closed ? 0 : m_file_out.reply;
+        m_file_out.reply = 0;
+        return reply;
+    };
+    
+    bool ok = false;
+    const char* error = NULL;
+    uint64_t start_ns = TraceNowNs();
+    uint64_t resume = 0;
+    if (name.size() >= FILE_NAME_MAX || !SendFileControl(stream_id, FILE_OFFER, 0, size, st.st_mtime, name.c_str())) {
+        error = "发送请求失败";
+    } else if (await_reply() != FILE_ACCEPT) {
+        error = "对端拒绝或没有回应";
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_file_out.mutex);
+            resume = std::min(m_file_out.resume_offset, size);
+        }
+        if (!m_quiet) {
+            printf("[文件] 开始发送 %s（%llu 字节", name.c_str(), (unsigned long long)size);
+            if (resume > 0) {
+                printf("，从 %llu 字节处续传", (unsigned long long)resume);
+            }
+            printf("）\n");
+            fflush(stdout);
+        }
+        // 对端放弃接收后停止读取，SendBulk随之返回
+        BulkReader reader = [this, fd, stream_id](char* out, uint64_t pos, int n) {
+            {
+                std::lock_guard<std::mutex> lock(m_file_out.mutex);
+                if (m_file_out.reply == FILE_ABORT || m_file_out.closed) {
+                    return false;
+                }
+            }
+            return PreadFull(fd, out, n, pos);
+        };
+        if (!SendBulk(stream_id, reader, size - resume, resume, true)) {
+            error = "传输中断";
+        } else if (await_reply() != FILE_DONE) {
+            error = "对端没有确认完成";
+        } else {
+            ok = true;
+        }
+    }
+    close(fd);
+    
+    uint64_t acked;
+    {
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        acked = m_file_out.acked;
+        m_file_out.stream_id = 0;
+    }
+    if (!ok) {
+        LOG_ERROR("文件发送失败（" + std::string(error) + "）: " + path + "，对端已确认 " + std::to_string(acked) + " 字节");
+        if (!m_quiet) {
+            std::cerr << "[文件] 发送失败（" << error << "）: " << name;
+            if (acked > 0) {
+                std::cerr << "，对端已确认 " << acked << " 字节，再次发送时从这里续传";
+            }
+            std::cerr << std::endl;
+        }
+        return false;
+    }
+    
+    static MetricCounter& files_sent = MetricsRegistry::GetInstance().Counter(
+        "chat_files_sent_total", "发送完成的文件数");
+    files_sent.Inc();
+    double seconds = (TraceNowNs() - start_ns) / 1e9;
+    LOG_INFO("文件发送完成: " + path);
+    if (!m_quiet) {
+        printf("[文件] 已发送 %s：%llu 字节，用时 %.2f 秒，%.2f MB/s\n", name.c_str(),
+               (unsigned long long)(size - resume), seconds,
+               seconds > 0 ? (size - resume) / seconds / (1024 * 1024) : 0.0);
+        fflush(stdout);
+    }
+    return true;
+}
+
+// /send命令：上一个文件发完之前不接受新的文件，传输在独立线程上进行，不阻塞聊天输入
+void CTcpSocket::StartFileTransfer(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        if (m_file_out.busy) {
+            std::cerr << "[文件] 上一个文件仍在发送" << std::endl;
+            return;
+        }
+        m_file_out.busy = true;
+    }
+    if (m_file_thread.joinable()) {
+        m_file_thread.join();
+    }
+    m_file_thread = std::thread([this, path]() {
+        SendFile(path);
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        m_file_out.busy = false;
+    });
+}
+
+// 探测应答到达：往返时间用本端单调时钟计算，单程时间比较两端实时时钟
+void CTcpSocket::HandleEcho(const char* plain, int plain_len) {
+    if (plain_len < (int)sizeof(PingPayload)) {
+        LOG_WARNING("探测应答长度不足: " + std::to_string(plain_len) + " 字节");
+        return;
+    }
+    PingPayload echo;
+    memcpy(&echo, plain, sizeof(echo));
+    uint64_t now = TraceNowNs();
+    uint64_t sent_mono = GetBigEndian64(echo.sent_mono);
+    uint64_t sent_real = GetBigEndian64(echo.sent_real);
+    uint64_t peer_recv_real = GetBigEndian64(echo.peer_recv_real);
+    if (sent_mono > now) {
+        return;
+    }
+    
+    PingRttHistogram().Record(now - sent_mono);
+    // 两端时钟不同步时单程时间可能为负，这种样本不计入
+    if (peer_recv_real >= sent_real) {
+        PingOneWayHistogram().Record(peer_recv_real - sent_real);
+    }
+    LOG_DEBUGF("探测应答 序号%u: 往返 %.1f us", ntohl(echo.probe_seq), (now - sent_mono) / 1000.0);
+}
+
+// 在控制台显示延迟统计
+void CTcpSocket::ShowLatency() {
+    MetricHistogram* histograms[] = {&PingRttHistogram(), &PingOneWayHistogram()};
+    static const char* const labels[] = {"往返", "单程"};
+    for (int i = 0; i < 2; i++) {
+        HistogramSnapshot snapshot = histograms[i]->Snapshot();
+        printf("[延迟] %s: 样本 %llu，p50 %.1f us，p99 %.1f us，p999 %.1f us，最大 %.1f us\n", labels[i],
+               (unsigned long long)snapshot.count, snapshot.Percentile(0.5) / 1000.0,
+               snapshot.Percentile(0.99) / 1000.0, snapshot.Percentile(0.999) / 1000.0, snapshot.max / 1000.0);
+    }
+    fflush(stdout);
+}
+
+// 设置定期探测间隔
+void CTcpSocket::SetProbeInterval(int interval_ms) {
+    m_probe_interval_ms = interval_ms;
+}
+
+// 定期探测线程：每隔m_probe_interval_ms发送一个探测帧
+void CTcpSocket::ProbeLoop(std::atomic<bool>& stop) {
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (!stop) {
+        next += std::chrono::milliseconds(m_probe_interval_ms);
+        while (!stop && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (stop || !SendPing()) {
+            break;
+        }
+    }
+}
+
+// 设置换钥阈值
+void CTcpSocket::SetRekeyPolicy(uint64_t bytes, int seconds) {
+    m_rekey_bytes = bytes;
+    m_rekey_seconds = seconds;
+}
+
+// 以握手得到的密钥初始化收发两个方向的密钥
+void CTcpSocket::ResetSessionKeys() {
+    m_send_keys.Reset(m_des_key);
+    m_recv_keys.Reset(m_des_key);
+    m_send_seq = 0;
+    m_send_key_version++;
+    m_bytes_since_rekey = 0;
+    m_last_rekey = time(nullptr);
+}
+
+// 发送方向换钥：新密钥先展开到空闲槽位，再用当前密钥发出换钥控制帧，
+// 下一帧起切换到新密钥
+bool CTcpSocket::SendRekey() {
+    char new_key[8];
+    std::random_device rd;
+    for (int i = 0; i < 8; i += 4) {
+        uint32_t r = rd();
+        memcpy(new_key + i, &r, 4);
+    }
+    
+    RekeyPayload rekey;
+    memset(&rekey, 0, sizeof(rekey));
+    memcpy(rekey.key, new_key, 8);
+    uint32_t activate_seq = m_send_seq + 1;
+    rekey.activate_seq = htonl(activate_seq);
+    m_send_keys.Prepare(new_key, activate_seq);
+    m_send_key_version++;
+    memset(new_key, 0, sizeof(new_key));
+    
+    char frame[sizeof(FrameHeader) + sizeof(RekeyPayload)];
+    int frame_len = BuildFrame(FRAME_REKEY, (char*)&rekey, sizeof(rekey), frame, sizeof(frame));
+    memset(&rekey, 0, sizeof(rekey));
+    if (frame_len < 0 || !SendData(frame, frame_len)) {
+        LOG_ERROR("发送换钥控制帧失败");
+        return false;
+    }
+    
+    m_bytes_since_rekey = 0;
+    m_last_rekey = time(nullptr);
+    LOG_INFO("发送方向换钥，新密钥自序号 " + std::to_string(activate_seq) + " 起生效（第 " +
+             std::to_string(m_send_keys.Generation() + 1) + " 次）");
+    return true;
+}
+
+// 处理对端的换钥控制帧：预先展开新密钥，到达生效序号时切换
+void CTcpSocket::HandleRekey(const char* plain, int plain_len) {
+    if (plain_len < (int)sizeof(RekeyPayload)) {
+        LOG_WARNING("换钥控制帧长度不足: " + std::to_string(plain_len) + " 字节");
+        return;
+    }
+    
+    RekeyPayload rekey;
+    memcpy(&rekey, plain, sizeof(rekey));
+    uint32_t activate_seq = ntohl(rekey.activate_seq);
+    m_recv_keys.Prepare(rekey.key, activate_seq);
+    memset(&rekey, 0, sizeof(rekey));
+    LOG_INFO("接收方向换钥，新密钥自序号 " + std::to_string(activate_seq) + " 起生效");
+}
+
+// 接收一帧：帧头转换为主机字节序，返回载荷长度；连接关闭返回0，出错返回-1
+int CTcpSocket::RecvFrame(FrameHeader& header, char* payload, int payload_size) {
+    int n = RecvData((char*)&header, sizeof(header));
+    if (n <= 0) {
+        return n;
+    }
+    if (n != (int)sizeof(header)) {
+        return 0;
+    }
+    
+    // 等待帧头的时间是空闲时间，区间从帧头到达后开始
+    TRACE_SPAN("chat", "recv");
+    header.length = ntohl(header.length);
+    header.seq = ntohl(header.seq);
+    header.checksum = ntohl(header.checksum);
+    
+    // 长度非法时无法再对齐后续帧，只能断开
+    if (header.length > FRAME_MAX_PAYLOAD || (int)header.length > payload_size) {
+        LOG_ERROR("帧长度非法: " + std::to_string(header.length) + " 字节");
+        return -1;
+    }
+    if (header.length == 0) {
+        return 0;
+    }
+    
+    n = RecvData(payload, header.length);
+    if (n != (int)header.length) {
+        return n < 0 ? -1 : 0;
+    }
+    return n;
+}
+
+// 校验并解密一帧，按帧序号选择密钥，结果以'\0'结尾；返回明文长度，失败返回-1
+int CTcpSocket::OpenFrame(const FrameHeader& header, const char* payload, char* plain, int plain_size) {
+    return OpenSealedFrame(m_des, m_recv_keys, header, payload, plain, plain_size);
+}
+
+// 校验并解密一帧（帧头为主机字节序）
+int CTcpSocket::OpenSealedFrame(const CDesOperate& des, SessionKeyRing& keys, const FrameHeader& header,
+                                const char* payload, char* plain, int plain_size) {
+    int n = header.length;
+    
+    // 检查数据长度 (至少需要8字节加密数据)
+    if (n < 8) {
+        LOG_WARNING("接收数据长度不足: " + std::to_string(n) + " 字节");
+        return -1;
+    }
+    
+    // 验证校验和
+    uint32_t calculated_crc;
+    {
+        TRACE_SPAN("chat", "verify");
+        calculated_crc = FrameChecksum(payload, n);
+    }
+    if (header.checksum != calculated_crc) {
+        static MetricCounter& checksum_failures = MetricsRegistry::GetInstance().Counter(
+            "chat_frame_checksum_failures_total", "帧校验和不匹配次数");
+        checksum_failures.Inc();
+        LOG_ERROR("校验和不匹配: 预期=" + std::to_string(header.checksum) + ", 计算=" + std::to_string(calculated_crc));
+        return -1;
+    }
+    
+    // 记录接收到的加密数据到日志
+    LOG_RECORD(DEBUG, LOGF_FRAME_RECV, header.checksum, LogBytes(payload, n), n, header.seq);
+    
+    // 解密消息
+    int decrypted_len = plain_size - 1;
+    TRACE_SPAN("chat", "decrypt");
+    if (!des.Decry(payload, n, plain, decrypted_len, keys.ForSeq(header.seq))) {
+        LOG_ERROR("解密失败，可能是密钥不匹配");
+        return -1;
+    }
+    
+    // 确保解密后的消息以null结尾
+    plain[decrypted_len] = '\0';
+    return decrypted_len;
+}
+
+// 服务端：读取握手消息后附带的第一条消息，accept为false时读取后丢弃
+bool CTcpSocket::RecvEarlyData(uint32_t frame_len, bool accept) {
+    FrameHeader header;
+    if (frame_len > sizeof(header) + BUFFER_SIZE) {
+        LOG_ERROR("0-RTT消息过长: " + std::to_string(frame_len) + " 字节");
+        return false;
+    }
+    
+    // 握手期间的临时缓冲区从缓冲池分配，不占用会话线程的栈
+    BufferArena arena;
+    char* payload = arena.Allocate(BUFFER_SIZE);
+    char* text = arena.Allocate(BUFFER_SIZE + 1);
+    int n = RecvFrame(header, payload, BUFFER_SIZE);
+    if (n <= 0 || sizeof(header) + n != frame_len) {
+        LOG_ERROR("接收0-RTT消息失败");
+        return false;
+    }
+    
+    if (!accept) {
+        static MetricCounter& rejected = MetricsRegistry::GetInstance().Counter(
+            "chat_early_data_rejected_total", "票据无效或已兑换而丢弃的0-RTT消息数");
+        rejected.Inc();
+        LOG_INFO("票据无效，丢弃0-RTT消息");
+        return true;
+    }
+    
+    int text_len;
+    if (header.type == FRAME_CHAT && (text_len = OpenFrame(header, payload, text, BUFFER_SIZE + 1)) >= 0) {
+        LOG_INFO("收到随握手到达的第一条消息");
+        m_early_len = text_len;
+        m_early_wire_len = frame_len;
+        if (m_on_message) {
+            m_on_message(text, text_len);
+        } else {
+            ShowMessage(text);
+        }
+    } else if (!m_quiet) {
+        std::cerr << "[错误] 数据校验失败" << std::endl;
+    }
+    return true;
+}
+
+// 在控制台显示收到的消息
+void CTcpSocket::ShowMessage(const char* text) {
+    TRACE_SPAN("chat", "render");
+    const char* peer_addr = m_is_server ? 
+                           inet_ntoa(m_client_addr.sin_addr) : 
+                           inet_ntoa(m_server_addr.sin_addr);
+    LOG_RECORD(DEBUG, LOGF_MESSAGE_RECV, peer_addr, text);
+    
+    // 控制台显示简洁信息
+    if (!m_quiet) {
+        std::cout << "[收到] " << text << std::endl;
+    }
+}
+
 // 加密聊天主函数
 bool CTcpSocket::SecretChat(const char* key, int key_len) {
-    if (m_client_socket < 0) {
+    if (m_client_socket < 0 || key_len != 8) {
         return false;
     }
+    if (key != m_des_key) {
+        memcpy(m_des_key, key, 8);
+        ResetSessionKeys();
+    }
     
     // 日志记录密钥信息，控制台只显示简短信息
-    std::stringstream ss;
-    ss << "使用DES密钥 (HEX): ";
-    for (int i = 0; i < key_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(key[i])) << " ";
-    }
-    LOG_DEBUG(ss.str());
+    LOG_DEBUG("使用DES密钥 (HEX): " + LogHexDump(key, key_len));
     
     // 验证DES密钥是否有效
     std::cout << "[安全通信] DES密钥验证" << std::endl;
@@ -526,183 +1846,199 @@ bool CTcpSocket::SecretChat(const char* key, int key_len) {
     std::cout << "---------------------------------------------" << std::endl;
     std::cout << "输入 'quit' 退出聊天" << std::endl;
     
-    // 创建子进程，实现全双工通信
-    pid_t pid = fork();
+    // 发送线程读取用户输入并发送，当前线程负责接收，实现全双工通信。
+    // 两个方向各自使用独立的密钥和序号，线程之间不共享可变状态。
+    std::atomic<bool> stop(false);
+    std::thread sender(&CTcpSocket::SendLoop, this, std::ref(stop));
+    std::thread prober;
+    if (m_probe_interval_ms > 0) {
+        prober = std::thread(&CTcpSocket::ProbeLoop, this, std::ref(stop));
+    }
     
-    if (pid < 0) {
-        // 创建子进程失败
-        LOG_ERROR("子进程创建失败: " + std::string(strerror(errno)));
-        std::cerr << "[错误] 无法启动通信进程" << std::endl;
-        return false;
-    } else if (pid == 0) {
-        // 子进程：负责发送消息
-        char input[BUFFER_SIZE];
-        char encrypted[BUFFER_SIZE + 4]; // 增加4字节CRC校验
-        
-        while (1) {
-            // 读取用户输入
-            if (fgets(input, BUFFER_SIZE, stdin) == NULL) {
-                break;
-            }
-            
-            // 去除换行符
-            int len = strlen(input);
-            if (len > 0 && input[len - 1] == '\n') {
-                input[len - 1] = '\0';
-                len--;
-            }
-            
-            // 检查是否退出
-            if (strcmp(input, "quit") == 0) {
-                LOG_INFO("用户请求退出聊天");
-                break;
-            }
-            
-            // 检查输入是否为空
-            if (len == 0) {
-                continue;
-            }
-            
-            // 加密消息
-            int encrypted_len = BUFFER_SIZE;
-            if (!m_des.Encry(input, len, encrypted + 4, encrypted_len, key, key_len)) {
-                LOG_ERROR("消息加密失败");
-                std::cerr << "[错误] 加密失败" << std::endl;
-                continue;
-            }
-            
-            // 计算并添加校验和
-            uint32_t crc = 0;
-            for (int i = 0; i < encrypted_len; i++) {
-                crc += (unsigned char)encrypted[i + 4];
+    ReceiveLoop(stop);
+    
+    // 结束发送线程
+    stop = true;
+    ConsoleInput::GetInstance().Wake();
+    sender.join();
+    if (prober.joinable()) {
+        prober.join();
+    }
+    if (m_file_thread.joinable()) {
+        m_file_thread.join();
+    }
+    LOG_INFO("聊天会话结束");
+    LOG_DEBUG("运行指标:\n" + MetricsRegistry::GetInstance().Summary());
+    
+    return true;
+}
+
+// 接收循环：校验解密每一帧，处理控制帧，聊天消息交给回调或显示在控制台
+bool CTcpSocket::ReceiveLoop(const std::atomic<bool>& stop) {
+    static MetricGauge& active_sessions = MetricsRegistry::GetInstance().Gauge(
+        "chat_active_sessions", "进行中的聊天会话数");
+    active_sessions.Add(1);
+    {
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        m_file_out.closed = false;
+    }
+    
+    // 批量数据块可达FRAME_MAX_PAYLOAD，收发缓冲从缓冲池分配
+    FrameHeader header;
+    PooledBuffer payload_buf(FRAME_MAX_PAYLOAD);
+    PooledBuffer decrypted_buf(FRAME_MAX_PAYLOAD);
+    char* payload = payload_buf.data();
+    char* decrypted = decrypted_buf.data();
+    
+    while (1) {
+        // 接收一帧加密消息
+        int n = RecvFrame(header, payload, FRAME_MAX_PAYLOAD);
+        if (n <= 0) {
+            if (stop) {
+                // 本端已请求退出
+            } else if (n < 0) {
+                LOG_ERROR("接收数据失败: " + std::string(strerror(errno)));
+                if (!m_quiet) {
+                    std::cerr << "[错误] 接收数据失败" << std::endl;
+                }
+            } else {
+                LOG_INFO("连接已关闭");
+                if (!m_quiet) {
+                    std::cout << "[通知] 连接已关闭" << std::endl;
+                }
             }
-            memcpy(encrypted, &crc, 4);
-            
-            // 详细加密信息写入日志
-            std::stringstream ss_hex;
-            ss_hex << "发送加密数据 (HEX): CRC=" << std::hex << crc << " | ";
-            for (int i = 0; i < (encrypted_len > 32 ? 32 : encrypted_len); i++) {
-                ss_hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(encrypted[i + 4])) << " ";
+            break;
+        }
+        
+        if (header.type != FRAME_CHAT && header.type != FRAME_REKEY &&
+            header.type != FRAME_PING && header.type != FRAME_ECHO && header.type != FRAME_BULK &&
+            header.type != FRAME_FILE) {
+            LOG_WARNING("忽略未知类型的帧: " + std::to_string(header.type));
+            continue;
+        }
+        
+        // 校验并解密消息
+        int plain_len = OpenFrame(header, payload, decrypted, FRAME_MAX_PAYLOAD);
+        if (plain_len < 0) {
+            if (!m_quiet) {
+                std::cerr << "[错误] 数据校验失败" << std::endl;
             }
-            if (encrypted_len > 32) ss_hex << "...";
-            ss_hex << " (" << std::dec << encrypted_len << "字节)";
-            LOG_DEBUG(ss_hex.str());
-            
-            // 控制台只显示简短信息
-            std::cout << "[发送] " << input << std::endl;
-            
-            // 发送加密消息
-            if (!SendData(encrypted, encrypted_len + 4)) {
-                LOG_ERROR("发送消息失败: " + std::string(strerror(errno)));
-                std::cerr << "[错误] 发送失败" << std::endl;
-                break;
+            continue;
+        }
+        CaptureWriter::GetInstance().RecordFrame(m_capture_id, header.type, plain_len, sizeof(header) + n);
+        
+        // 控制帧不显示给用户
+        if (header.type == FRAME_REKEY) {
+            HandleRekey(decrypted, plain_len);
+            continue;
+        }
+        if (header.type == FRAME_PING) {
+            if (!HandlePing(decrypted, plain_len)) {
+                break;      // 对端已关闭，不再处理已缓冲的探测帧
             }
+            continue;
+        }
+        if (header.type == FRAME_ECHO) {
+            HandleEcho(decrypted, plain_len);
+            continue;
+        }
+        if (header.type == FRAME_BULK) {
+            HandleBulk(decrypted, plain_len);
+            continue;
+        }
+        if (header.type == FRAME_FILE) {
+            HandleFileControl(decrypted, plain_len);
+            continue;
         }
         
-        // 子进程结束
-        LOG_DEBUG("发送进程结束");
-        exit(0);
-    } else {
-        // 父进程：负责接收消息
-        char buffer[BUFFER_SIZE + 4]; // 增加4字节CRC校验
-        char decrypted[BUFFER_SIZE];
+        // 显示解密后的消息
+        if (m_on_message) {
+            m_on_message(decrypted, strlen(decrypted));
+        } else {
+            ShowMessage(decrypted);
+        }
+    }
+    
+    // 未完成的文件保留进度；等待对端回复的传输线程不再等待
+    m_file_in.Close();
+    {
+        std::lock_guard<std::mutex> lock(m_file_out.mutex);
+        m_file_out.closed = true;
+    }
+    m_file_out.cond.notify_all();
+    
+    CaptureWriter::GetInstance().CloseConnection(m_capture_id);
+    m_capture_id = 0;
+    active_sessions.Add(-1);
+    return true;
+}
+
+// 发送线程：读取用户输入并加密发送，stop被置位或标准输入结束时退出
+void CTcpSocket::SendLoop(std::atomic<bool>& stop) {
+    std::string input;
+    uint64_t arrived_ns = 0;
+    
+    while (ConsoleInput::GetInstance().ReadLine(input, stop, &arrived_ns)) {
+        // 从读入一行到发送线程取走该行的时间
+        TraceRecorder::GetInstance().Record("chat", "read-input", arrived_ns, TraceNowNs());
         
-        // 设置信号处理，防止子进程成为僵尸进程
-        signal(SIGCHLD, SIG_IGN);
+        // 检查是否退出：关闭连接，使接收循环同时结束
+        if (input == "quit") {
+            LOG_INFO("用户请求退出聊天");
+            stop = true;
+            shutdown(m_client_socket, SHUT_RDWR);
+            break;
+        }
         
-        while (1) {
-            // 接收加密消息
-            int n = RecvData(buffer, BUFFER_SIZE + 4);
-            if (n <= 0) {
-                if (n < 0) {
-                    LOG_ERROR("接收数据失败: " + std::string(strerror(errno)));
-                    std::cerr << "[错误] 接收数据失败" << std::endl;
-                } else {
-                    LOG_INFO("连接已关闭");
-                    std::cout << "[通知] 连接已关闭" << std::endl;
-                }
-                break;
-            }
-            
-            // 检查数据长度 (至少需要4字节CRC + 8字节加密数据)
-            if (n <= 12) {
-                LOG_WARNING("接收数据长度不足: " + std::to_string(n) + " 字节");
-                continue;
-            }
-            
-            // 提取校验和
-            uint32_t received_crc;
-            memcpy(&received_crc, buffer, 4);
-            
-            // 计算校验和
-            uint32_t calculated_crc = 0;
-            for (int i = 4; i < n; i++) {
-                calculated_crc += (unsigned char)buffer[i];
-            }
-            
-            // 验证校验和
-            if (received_crc != calculated_crc) {
-                LOG_ERROR("校验和不匹配: 预期=" + std::to_string(received_crc) + ", 计算=" + std::to_string(calculated_crc));
-                std::cerr << "[错误] 数据校验失败" << std::endl;
-                continue;
-            }
-            
-            // 记录接收到的加密数据到日志
-            std::stringstream ss_hex;
-            ss_hex << "接收加密数据 (HEX): CRC=" << std::hex << received_crc << " | ";
-            for (int i = 0; i < ((n-4) > 32 ? 32 : (n-4)); i++) {
-                ss_hex << std::setw(2) << std::setfill('0') << static_cast<int>(static_cast<unsigned char>(buffer[i + 4])) << " ";
+        // 检查输入是否为空
+        if (input.empty()) {
+            continue;
+        }
+        
+        // 延迟探测命令：/ping [次数] 发送探测帧，/latency 显示统计
+        if (input.compare(0, 5, "/ping") == 0 && (input.size() == 5 || input[5] == ' ')) {
+            // 次数非正时取默认值，并限制上限，避免输入线程长时间阻塞在发送间隔上
+            int count = input.size() > 6 ? atoi(input.c_str() + 6) : PING_DEFAULT_COUNT;
+            if (count <= 0) {
+                count = PING_DEFAULT_COUNT;
+            } else if (count > PING_MAX_COUNT) {
+                count = PING_MAX_COUNT;
             }
-            if (n-4 > 32) ss_hex << "...";
-            ss_hex << " (" << std::dec << (n-4) << "字节)";
-            LOG_DEBUG(ss_hex.str());
-            
-            // 解密消息
-            int decrypted_len = BUFFER_SIZE;
-            if (!m_des.Decry(buffer + 4, n - 4, decrypted, decrypted_len, key, key_len)) {
-                LOG_ERROR("解密失败，可能是密钥不匹配");
-                
-                // 调试信息: 尝试猜测可能的密钥偏移问题
-                LOG_DEBUG("尝试修复解密问题...");
-                char temp_key[8];
-                memcpy(temp_key, key, key_len);
-                
-                // 尝试字节序翻转
-                for (int i = 0; i < key_len/2; i++) {
-                    char t = temp_key[i];
-                    temp_key[i] = temp_key[key_len-1-i];
-                    temp_key[key_len-1-i] = t;
+            int sent = 0;
+            for (int i = 0; i < count && !stop; i++) {
+                if (i > 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(PING_SPACING_MS));
                 }
-                
-                if (m_des.Decry(buffer + 4, n - 4, decrypted, decrypted_len, temp_key, key_len)) {
-                    LOG_WARNING("字节序翻转后可以解密成功，请检查密钥交换逻辑");
+                if (!SendPing()) {
+                    break;
                 }
-                
-                std::cerr << "[错误] 解密失败" << std::endl;
-                continue;
+                sent++;
             }
-            
-            // 确保解密后的消息以null结尾
-            if (decrypted_len < BUFFER_SIZE)
-                decrypted[decrypted_len] = '\0';
-            else
-                decrypted[BUFFER_SIZE - 1] = '\0';
-            
-            // 显示解密后的消息
-            const char* peer_addr = m_is_server ? 
-                                   inet_ntoa(m_client_addr.sin_addr) : 
-                                   inet_ntoa(m_server_addr.sin_addr);
-            LOG_DEBUG("从 " + std::string(peer_addr) + " 接收到解密消息: " + std::string(decrypted));
-            
-            // 控制台显示简洁信息
-            std::cout << "[收到] " << decrypted << std::endl;
+            printf("[延迟] 已发送 %d 个探测帧，输入 /latency 查看统计\n", sent);
+            fflush(stdout);
+            continue;
+        }
+        if (input == "/latency") {
+            ShowLatency();
+            continue;
+        }
+        // 文件传输命令：/send <文件>，在后台发送，期间可以继续聊天
+        if (input.compare(0, 6, "/send ") == 0 && input.size() > 6) {
+            StartFileTransfer(input.substr(6));
+            continue;
         }
         
-        // 关闭子进程
-        kill(pid, SIGTERM);
-        waitpid(pid, NULL, 0);
-        LOG_INFO("聊天会话结束");
+        // 控制台只显示简短信息
+        std::cout << "[发送] " << input << std::endl;
+        
+        // 加密并发送消息
+        TRACE_SPAN("chat", "send-message");
+        if (!SendChatMessage(input.c_str(), input.size())) {
+            LOG_ERROR("发送消息失败: " + std::string(strerror(errno)));
+            std::cerr << "[错误] 发送失败" << std::endl;
+            break;
+        }
     }
     
-    return true;
-}
\ No newline at end of file
+    LOG_DEBUG("发送线程结束");
+}
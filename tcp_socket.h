@@ -7,20 +7,44 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
 #include <errno.h>
 #include <sys/wait.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include "des.h"
 #include "rsa.h" // 添加RSA头文件
 #include "logger.h" // 添加日志系统头文件
+#include "protocol.h"
+#include "session_ticket.h"
+#include "crypto_pool.h"
+#include "session_keys.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "buffer_pool.h"
+#include "send_lanes.h"
+#include "file_transfer.h"
 
 // 定义常量
 #define BUFFER_SIZE 1024  // 缓冲区大小
 #define DEFAULT_PORT 8888  // 默认端口号
 #define MAX_CONN 5        // 最大连接数
+#define FRAME_BUFFER_SIZE (sizeof(FrameHeader) + BUFFER_SIZE)  // 单条聊天消息帧的最大长度
+#define REKEY_BYTES (1024 * 1024)  // 默认每发送1MB换钥一次
+#define REKEY_SECONDS 600          // 默认每10分钟换钥一次
+#define PING_DEFAULT_COUNT 10      // /ping命令默认发送的探测帧数
+#define PING_SPACING_MS 10         // /ping命令相邻探测帧的间隔
+#define PING_MAX_COUNT 1000        // /ping命令单次最多发送的探测帧数
+#define RSA_KEY_POOL_SIZE 4        // 预先生成的RSA密钥对数量
 
 // TCP通信模块类
 class CTcpSocket {
@@ -30,25 +54,103 @@ public:
 
     // 服务器端方法
     bool InitServer(int port = DEFAULT_PORT);  // 初始化服务器
-    bool StartListen();                        // 开始监听
+    bool StartListen(int backlog = MAX_CONN);  // 开始监听
     int AcceptConnection();                    // 接受连接
+    int AcceptClient(struct sockaddr_in& addr);  // 接受一个连接并返回描述符，不改变当前连接
     bool StartSecureServer();                  // 启动服务端安全通信，包含RSA密钥交换
+    bool EstablishSecureServer(bool& resumed);   // 完成服务端握手并记录耗时，resumed返回是否通过票据恢复
+
+    // 多会话服务器：接管已接受的连接，票据管理器由所有会话共享，以便客户端凭票据恢复到任意会话
+    void AdoptClient(int fd, const struct sockaddr_in& addr, SessionTicketManager* tickets);
 
     // 客户端方法
     bool ConnectToServer(const char* server_ip, int port = DEFAULT_PORT);  // 连接到服务器
     bool StartSecureClient();                  // 启动客户端安全通信，包含RSA密钥交换
+    bool EstablishSecureClient();              // 只完成客户端握手，不进入交互聊天
+    void SetSessionResumption(bool enable) { m_resumption = enable; }  // 是否读取与保存会话票据
+    void SetFastOpen(bool enable) { m_fast_open = enable; }  // 连接时启用TCP Fast Open
+    void SetEarlyData(const char* data, int data_len);       // 设置随密钥交换一并发送的第一条消息
 
     // 通用方法
     bool SendData(const char* data, int data_len);  // 发送数据
     int RecvData(char* buffer, int buffer_size);    // 接收数据
     int TotalRecv(int sockfd, char* buffer, int buffer_size);  // 确保完整接收数据
     void CloseSocket();                              // 关闭套接字
+    void CloseClientSocket();                        // 关闭当前客户端连接，保留监听套接字
 
     // 加密通信方法
     bool SecretChat(const char* key, int key_len);   // 加密聊天主函数
+    bool ReceiveLoop(const std::atomic<bool>& stop); // 接收并处理帧，直到连接关闭；stop被置位时不再报告错误
+    bool SendPing(int size = sizeof(PingPayload));   // 发送一个延迟探测帧，size为明文长度（含填充）
+    int BuildFrame(uint8_t type, const char* data, int data_len, char* frame, int frame_size);  // 加密并封装一帧
+    int BuildChatFrame(const char* text, int text_len, char* frame, int frame_size);  // 加密并封装聊天消息帧
+    bool SendChatMessage(const char* text, int text_len);                             // 发送一条聊天消息
+    // 在批量通道上发送一段数据：按块大小拆成多个块帧，每块之间让出发送方向，控制帧与聊天消息优先写入。
+    // offset为data在流中的起始偏移，last表示这是流的最后一段
+    bool SendBulk(uint32_t stream_id, const char* data, uint64_t len, uint64_t offset = 0, bool last = true);
+    // 同上，数据由read按流中的偏移读入缓冲（可能在加密线程上调用），read返回false时中止发送
+    typedef std::function<bool(char*, uint64_t, int)> BulkReader;
+    bool SendBulk(uint32_t stream_id, const BulkReader& read, uint64_t len, uint64_t offset = 0, bool last = true);
+    bool SendFile(const std::string& path);          // 发送一个文件，对端有未完成的同一文件时从其确认的偏移续传
+    void SetReceiveDir(const std::string& dir) { m_recv_dir = dir; }  // 收到的文件存放的目录
+    void SetBulkChunkSize(int bytes);                // 批量数据的块大小，决定聊天消息最多被阻塞多久
+    int RecvFrame(FrameHeader& header, char* payload, int payload_size);              // 接收一帧，返回载荷长度
     void GenerateDesKey(char* key, int key_len);     // 生成随机DES密钥
+    void SetRekeyPolicy(uint64_t bytes, int seconds);  // 设置换钥阈值，0表示不按该条件换钥
+    void SetProbeInterval(int interval_ms);          // 聊天期间定期发送延迟探测帧，0表示关闭
+    void SetQuiet(bool quiet) { m_quiet = quiet; }   // 不在控制台显示连接与收到的消息
+    void ShutdownConnection();                       // 关闭当前连接的读写两个方向，唤醒阻塞在接收上的线程
+    void SetIoTimeout(int timeout_ms);               // 连接、收发的超时（毫秒），0表示不超时
+    struct sockaddr_in GetPeerAddr() const { return m_is_server ? m_client_addr : m_server_addr; }  // 对端地址
+    // 收到聊天消息时的回调，设置后代替控制台显示（多会话服务器用它转发消息）
+    void SetMessageHandler(std::function<void(const char*, int)> handler) { m_on_message = handler; }
+    // 收到批量数据块时的回调（流编号、偏移、数据、长度、是否最后一块），未设置时只计数后丢弃
+    typedef std::function<void(uint32_t, uint64_t, const char*, int, bool)> BulkHandler;
+    void SetBulkHandler(BulkHandler handler) { m_on_bulk = handler; }
+
+    // 帧编解码，不依赖连接状态（多会话服务器的事件循环也使用）
+    static int SealFrame(const CDesOperate& des, SessionKeyRing& keys, uint32_t seq, uint8_t type,
+                         const char* data, int data_len, char* frame, int frame_size);
+    static int SealFrame(const CDesOperate& des, const DesKeySchedule& schedule, uint32_t seq, uint8_t type,
+                         const char* data, int data_len, char* frame, int frame_size);
+    static int OpenSealedFrame(const CDesOperate& des, SessionKeyRing& keys, const FrameHeader& header,
+                               const char* payload, char* plain, int plain_size);
+
+    // 握手完成后把连接交给事件循环：取走描述符（本对象不再关闭它）与会话状态
+    int DetachClient();
+    const char* SessionKey() const { return m_des_key; }
+    uint32_t SendSeq() const { return m_send_seq; }
+    uint32_t CaptureId() const { return m_capture_id; }
+
+    // 会话票据统计（服务端）
+    TicketCacheStats GetTicketStats() const { return m_tickets->GetStats(); }
 
 private:
+    bool ServerHandshake(bool& resumed);             // 服务端握手，resumed返回是否通过票据恢复
+    bool IssueTicket();                              // 服务端：签发并发送会话票据
+    bool ReceiveTicket();                            // 客户端：接收并保存会话票据
+    int OpenFrame(const FrameHeader& header, const char* payload, char* plain, int plain_size);  // 校验并解密一帧
+    void ResetSessionKeys();                         // 以握手得到的密钥初始化收发两个方向的密钥
+    bool SendRekey();                                // 发送方向换钥
+    void HandleRekey(const char* plain, int plain_len);  // 处理对端的换钥控制帧
+    bool RecvEarlyData(uint32_t frame_len, bool accept);  // 服务端：读取握手消息后附带的第一条消息
+    void ShowMessage(const char* text);              // 在控制台显示收到的消息
+    void SendLoop(std::atomic<bool>& stop);          // 发送线程：读取用户输入并发送
+    bool SendControlFrame(uint8_t type, const char* data, int data_len);  // 加密并发送一个控制帧
+    bool HandlePing(const char* plain, int plain_len);   // 回应对端的探测帧，发送失败返回false
+    void HandleEcho(const char* plain, int plain_len);   // 根据探测应答记录往返与单程延迟
+    void HandleBulk(const char* plain, int plain_len);   // 把批量数据块写入接收中的文件或交给回调
+    bool SendFileControl(uint32_t stream_id, uint32_t op, uint64_t offset, uint64_t size = 0,
+                         int64_t mtime = 0, const char* name = "");
+    void HandleFileControl(const char* plain, int plain_len);  // 处理对端的文件传输控制帧
+    void AbortIncomingFile(const char* reason);      // 放弃接收中的文件并通知对端
+    void StartFileTransfer(const std::string& path); // /send命令：在传输线程上发送文件
+    void ProbeLoop(std::atomic<bool>& stop);         // 定期探测线程
+    bool RekeyIfDue();                               // 达到换钥阈值时先换钥，调用方持有发送通道
+    uint32_t NextSendKey(DesKeySchedule& schedule);  // 复制下一帧将使用的密钥编排，返回密钥版本；调用方持有发送通道
+    void ShowLatency();                              // 在控制台显示延迟统计
+    void ApplyIoTimeout(int fd);                     // 把收发超时设置到套接字上
+
     int m_socket;                // 套接字描述符
     int m_client_socket;         // 客户端套接字描述符
     struct sockaddr_in m_server_addr;  // 服务器地址
@@ -58,6 +160,44 @@ private:
     
     RSA m_rsa;                   // RSA加密对象
     char m_des_key[8];           // DES密钥
+
+    SessionTicketManager m_own_tickets;  // 本对象自有的票据管理器
+    SessionTicketManager* m_tickets;     // 实际使用的票据管理器（服务端），多会话服务器中指向共享实例
+    bool m_resumption;                   // 客户端是否读取与保存会话票据
+    bool m_quiet;                        // 是否关闭控制台提示
+    std::function<void(const char*, int)> m_on_message;  // 聊天消息回调
+    BulkHandler m_on_bulk;                               // 批量数据回调
+    bool m_fast_open;                // 是否使用TCP Fast Open连接
+    int m_io_timeout_ms;             // 连接与收发超时，0表示不超时
+
+    SessionKeyRing m_send_keys;      // 发送方向密钥（双缓冲）
+    SessionKeyRing m_recv_keys;      // 接收方向密钥（双缓冲）
+    uint32_t m_send_seq;             // 下一帧的发送序号
+    uint32_t m_send_key_version;     // 发送方向每准备一把新密钥加一，批量数据据此判断预先加密的块是否仍然有效
+    SendLanes m_lanes;               // 发送方向的帧序号、密钥与写入顺序：发送、探测、批量与回应探测的接收线程按优先级共用
+    int m_bulk_chunk;                // 批量数据的块大小
+    uint32_t m_next_stream;          // 下一个批量数据流编号
+    FileSendState m_file_out;        // 正在发送的文件，传输线程与接收线程共用
+    std::thread m_file_thread;       // /send命令的传输线程
+    FileReceiver m_file_in;          // 正在接收的文件，只由接收线程访问
+    std::string m_recv_dir;          // 收到的文件存放的目录
+    uint32_t m_probe_seq;            // 下一个探测帧的序号
+    int m_probe_interval_ms;         // 定期探测间隔，0表示不定期探测
+    uint64_t m_rekey_bytes;          // 换钥字节阈值
+    int m_rekey_seconds;             // 换钥时间阈值（秒）
+    uint64_t m_bytes_since_rekey;    // 上次换钥后已发送的字节数
+    time_t m_last_rekey;             // 上次换钥时间
+    std::string m_early_data;        // 待随握手发送的第一条消息（客户端）
+    uint32_t m_capture_id;           // 流量捕获中的连接编号，0表示不捕获
+    int m_early_len;                 // 服务端：握手中收到的0-RTT消息明文长度，-1表示没有
+    int m_early_wire_len;            // 服务端：该消息帧在线路上的长度
 };
 
+// 探测帧往返与单程延迟直方图（进程内所有连接共用）
+MetricHistogram& PingRttHistogram();
+MetricHistogram& PingOneWayHistogram();
+
+// 实时时钟纳秒数，探测帧用它估算单程延迟
+uint64_t RealtimeNs();
+
 #endif // TCP_SOCKET_H
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)      // 每级64个槽位
+#define WHEEL_MAX_TICKS ((1U << (WHEEL_LEVELS * WHEEL_BITS)) - 1)   // 最远可安排的节拍数
+
+// 分层时间轮
+// 四级各64个槽位，第0级每个槽位一个节拍，上一级每个槽位覆盖下一级一整圈；到期较远的定时器放在高层，
+// 低层转完一圈时把高层对应槽位的定时器重新分配到低层。安排、取消都是O(1)，每个节拍只处理到期的槽位。
+// 定时器以非负整数编号（如描述符），节点保存在按编号索引的数组中，槽位是以下标相连的双向链表，
+// 每个定时器只占16字节且不需要单独分配。不是线程安全的。
+class TimerWheel {
+public:
+    explicit TimerWheel(uint32_t tick_ms) : m_tick_ms(tick_ms), m_now(0), m_count(0) {
+        for (int i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++) {
+            m_heads[i] = -1;
+        }
+    }
+
+    // 以毫秒时间设定当前时刻，只在安排第一个定时器之前调用
+    void Start(uint64_t now_ms) { m_now = (uint32_t)(now_ms / m_tick_ms); }
+
+    // 安排id在delay_ms后到期，已安排的定时器改为新的到期时间
+    void Schedule(int id, uint64_t delay_ms) {
+        if (id >= (int)m_nodes.size()) {
+            size_t size = m_nodes.empty() ? 1024 : m_nodes.size();
+            while (size <= (size_t)id) {
+                size *= 2;
+            }
+            m_nodes.resize(size);
+        }
+        Cancel(id);
+        uint64_t ticks = (delay_ms + m_tick_ms - 1) / m_tick_ms;
+        if (ticks == 0) {
+            ticks = 1;
+        } else if (ticks > WHEEL_MAX_TICKS) {
+            ticks = WHEEL_MAX_TICKS;
+        }
+        m_nodes[id].expire = m_now + (uint32_t)ticks;
+        Link(id);
+        m_count++;
+    }
+
+    void Cancel(int id) {
+        if (Pending(id)) {
+            Unlink(id);
+            m_count--;
+        }
+    }
+
+    bool Pending(int id) const {
+        return id >= 0 && id < (int)m_nodes.size() && m_nodes[id].list >= 0;
+    }
+
+    // 推进到now_ms，对每个到期的定时器调用on_expire(id)；回调中可以重新安排或取消任意定时器
+    template <typename F>
+    void Advance(uint64_t now_ms, F on_expire) {
+        uint32_t target = (uint32_t)(now_ms / m_tick_ms);
+        if (m_count == 0) {
+            m_now = target;       // 没有定时器时直接跳到当前节拍
+            return;
+        }
+        while ((int32_t)(target - m_now) > 0) {
+            m_now++;
+            // 第0级转完一圈，逐级把高层槽位的定时器分配到低层
+            for (int level = 1; level < WHEEL_LEVELS; level++) {
+                if ((m_now & ((1U << (level * WHEEL_BITS)) - 1)) != 0) {
+                    break;
+                }
+                Cascade(level * WHEEL_SLOTS + ((m_now >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1)));
+            }
+
+            int list = m_now & (WHEEL_SLOTS - 1);
+            while (m_heads[list] >= 0) {
+                int id = m_heads[list];
+                Unlink(id);
+                m_count--;
+                on_expire(id);
+            }
+        }
+    }
+
+    size_t Count() const { return m_count; }
+    uint32_t TickMs() const { return m_tick_ms; }
+
+private:
+    struct Node {
+        int32_t prev;
+        int32_t next;
+        uint32_t expire;     // 到期节拍
+        int32_t list;        // 所在槽位（级别*64+槽位），-1表示未安排
+
+        Node() : prev(-1), next(-1), expire(0), list(-1) {}
+    };
+
+    // 按剩余节拍数选择级别与槽位并插入链表头
+    void Link(int id) {
+        Node& node = m_nodes[id];
+        uint32_t delta = node.expire - m_now;
+        if ((int32_t)delta < 0) {
+            delta = 0;
+        }
+        int level = 0;
+        while (level < WHEEL_LEVELS - 1 && delta >= (1U << ((level + 1) * WHEEL_BITS))) {
+            level++;
+        }
+        int list = level * WHEEL_SLOTS + ((node.expire >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1));
+        node.list = list;
+        node.prev = -1;
+        node.next = m_heads[list];
+        if (node.next >= 0) {
+            m_nodes[node.next].prev = id;
+        }
+        m_heads[list] = id;
+    }
+
+    void Unlink(int id) {
+        Node& node = m_nodes[id];
+        if (node.prev >= 0) {
+            m_nodes[node.prev].next = node.next;
+        } else {
+            m_heads[node.list] = node.next;
+        }
+        if (node.next >= 0) {
+            m_nodes[node.next].prev = node.prev;
+        }
+        node.list = -1;
+    }
+
+    // 把一个高层槽位中的定时器重新分配到低层
+    void Cascade(int list) {
+        int id = m_heads[list];
+        m_heads[list] = -1;
+        while (id >= 0) {
+            int next = m_nodes[id].next;
+            Link(id);
+            id = next;
+        }
+    }
+
+    uint32_t m_tick_ms;
+    uint32_t m_now;                                  // 当前节拍
+    size_t m_count;                                  // 已安排的定时器数
+    int32_t m_heads[WHEEL_LEVELS * WHEEL_SLOTS];     // 各槽位链表头
+    std::vector<Node> m_nodes;                       // 按编号索引的定时器节点
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,185 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TRACE_CAPACITY 16384   // 默认保留最近16384个区间
+
+// 单调时钟纳秒数
+inline uint64_t TraceNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 当前线程的内核线程号，Chrome trace中按它分行显示
+inline uint32_t TraceThreadId() {
+    static thread_local uint32_t tid = (uint32_t)syscall(SYS_gettid);
+    return tid;
+}
+
+// 区间记录器
+// 区间写入固定容量的环形缓冲区，写满后覆盖最旧的记录；每个槽位带序号，
+// 导出时跳过正在被改写的槽位，写入方不加锁。未启用时TRACE_SPAN只检查一次原子标志。
+class TraceRecorder {
+public:
+    static TraceRecorder& GetInstance() {
+        static TraceRecorder instance;
+        return instance;
+    }
+
+    bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 分配环形缓冲区并开始记录，capacity向上取整到2的幂；只能调用一次
+    void Enable(size_t capacity = TRACE_CAPACITY) {
+        if (Enabled()) {
+            return;
+        }
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_slots = std::vector<Slot>(size);
+        m_mask = size - 1;
+        m_enabled.store(true, std::memory_order_release);
+    }
+
+    // 记录一个区间，name与category须为字符串常量
+    void Record(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns) {
+        if (!m_enabled.load(std::memory_order_acquire)) {
+            return;
+        }
+        uint64_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = m_slots[index & m_mask];
+        slot.seq.store(index * 2 + 1, std::memory_order_relaxed);      // 奇数：写入中
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.category = category;
+        slot.name = name;
+        slot.start_ns = start_ns;
+        slot.dur_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+        slot.tid = TraceThreadId();
+        slot.seq.store(index * 2 + 2, std::memory_order_release);
+    }
+
+    // 以Chrome trace-event JSON格式导出缓冲区中的区间（可在chrome://tracing或Perfetto中打开）
+    std::string ChromeJson() const {
+        std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        int pid = getpid();
+        uint64_t end = m_next.load(std::memory_order_acquire);
+        uint64_t begin = end > m_slots.size() ? end - m_slots.size() : 0;
+        for (uint64_t index = begin; index < end; index++) {
+            const Slot& slot = m_slots[index & m_mask];
+            if (slot.seq.load(std::memory_order_acquire) != index * 2 + 2) {
+                continue;
+            }
+            const char* category = slot.category;
+            const char* name = slot.name;
+            uint64_t start_ns = slot.start_ns;
+            uint64_t dur_ns = slot.dur_ns;
+            uint32_t tid = slot.tid;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != index * 2 + 2) {
+                continue;   // 读取期间被覆盖
+            }
+
+            char event[256];
+            snprintf(event, sizeof(event),
+                     "%s\n{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,"
+                     "\"pid\":%d,\"tid\":%u}",
+                     first ? "" : ",", category, name,
+                     (unsigned long long)(start_ns / 1000), (unsigned)(start_ns % 1000),
+                     (unsigned long long)(dur_ns / 1000), (unsigned)(dur_ns % 1000), pid, tid);
+            out += event;
+            first = false;
+        }
+        out += "\n]}\n";
+        return out;
+    }
+
+    bool DumpToFile(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL) {
+            perror("trace dump");
+            return false;
+        }
+        std::string json = ChromeJson();
+        bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    // 收到SIGUSR1时把区间导出到path。须在启动其他线程之前调用：
+    // 信号在所有线程中被屏蔽，由专门的线程sigwait后在普通上下文中导出
+    void DumpOnSignal(const std::string& path) {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &set, NULL);
+        std::thread([this, path, set]() {
+            int signo;
+            while (sigwait(&set, &signo) == 0) {
+                if (DumpToFile(path)) {
+                    fprintf(stderr, "追踪数据已导出到 %s\n", path.c_str());
+                }
+            }
+        }).detach();
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;      // 写入第i个区间时为2i+1，写完为2i+2
+        const char* category;
+        const char* name;
+        uint64_t start_ns;
+        uint64_t dur_ns;
+        uint32_t tid;
+
+        Slot() : seq(0), category(""), name(""), start_ns(0), dur_ns(0), tid(0) {}
+        Slot(const Slot&) : Slot() {}
+    };
+
+    TraceRecorder() : m_enabled(false), m_next(0), m_mask(0) {}
+
+    std::atomic<bool> m_enabled;
+    std::atomic<uint64_t> m_next;       // 下一个区间的编号
+    std::vector<Slot> m_slots;
+    uint64_t m_mask;
+};
+
+// 作用域区间：构造时开始，析构时记录
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name)
+        : m_category(category), m_name(TraceRecorder::GetInstance().Enabled() ? name : NULL),
+          m_start(m_name ? TraceNowNs() : 0) {}
+
+    ~TraceSpan() {
+        if (m_name != NULL) {
+            TraceRecorder::GetInstance().Record(m_category, m_name, m_start, TraceNowNs());
+        }
+    }
+
+private:
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    const char* m_category;
+    const char* m_name;     // 未启用时为NULL
+    uint64_t m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(category, name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(category, name)
+
+#endif // TRACE_H